@@ -0,0 +1,288 @@
+#include "ApproximateCounter.h"
+#include "ClusterCounter.h"
+#include "DisjointSet.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace clusters{
+    namespace{
+
+        // @constant PILOT_TILES Number of tiles sampled to estimate the variance of the tile shares.
+        constexpr long long PILOT_TILES = 64;
+
+        /**
+        * @struct TileScratch
+        *
+        * @brief Buffers reused from one sampled tile to the next.
+        */
+        struct TileScratch{
+            std::vector<unsigned char> cells;
+            std::vector<int> labels;
+            std::vector<size_t> anchors;        // first cell of every background set, in row-major order
+            std::vector<unsigned char> touches; // whether the set reaches the window border
+            DisjointSet sets;
+        };
+
+        /**
+        * @brief Returns four times the Euler number of the 2x2 patterns of a cell buffer.
+        *
+        * Bit-quad formula for 4-connectivity: E = (n1 - n3 + 2 nD) / 4, where n1 and n3 count the
+        * patterns with one and three 'true' cells and nD the two diagonal patterns.
+        */
+        long long quad_euler(const std::vector<unsigned char>& cells, int stride,
+                             int first_row, int last_row, int first_col, int last_col){
+            long long result = 0;
+            for (int row = first_row; row <= last_row; row++){
+                const unsigned char* upper = cells.data() + static_cast<size_t>(row - 1) * stride;
+                const unsigned char* lower = upper + stride;
+                for (int col = first_col; col <= last_col; col++){
+                    const int a = upper[col - 1], b = upper[col], c = lower[col - 1], d = lower[col];
+                    const int ones = a + b + c + d;
+                    if (ones == 1) {
+                        result += 1;
+                    } else if (ones == 3) {
+                        result -= 1;
+                    } else if (ones == 2 && a == d) {
+                        result += 2;
+                    }
+                }
+            }
+            return result;
+        }
+
+        /**
+        * @brief Computes the share of one tile in the estimated count.
+        *
+        * The tile is copied together with a window around it: one row above, and `margin` cells
+        * to the left, to the right and below; cells outside the grid are 'false'. The share of
+        * the Euler number comes from the 2x2 patterns whose lower-right cell lies in the tile
+        * (the last tile row and column also own the patterns hanging over the grid edge). A hole
+        * is an 8-connected component of 'false' cells that does not reach the window border,
+        * and it belongs to the tile holding its first cell in row-major order, so every hole
+        * that fits in the window of its tile is counted exactly once over all tiles.
+        */
+        double tile_share(const std::vector<std::vector<bool>>& grid, int top, int left, int tile_size, int margin,
+                          TileScratch& scratch){
+            const int rows = grid.size();
+            const int cols = grid[0].size();
+            const int height = std::min(tile_size, rows - top);
+            const int width = std::min(tile_size, cols - left);
+            const int window_top = top - 1;
+            const int window_left = left - margin;
+            const int window_height = height + 1 + margin;
+            const int stride = width + 2 * margin;
+
+            std::vector<unsigned char>& cells = scratch.cells;
+            cells.assign(static_cast<size_t>(window_height) * stride, 0);
+            for (int row = std::max(0, -window_top); row < window_height && window_top + row < rows; row++){
+                const auto& source = grid[window_top + row];
+                unsigned char* target = cells.data() + static_cast<size_t>(row) * stride;
+                const int first = std::max(0, -window_left);
+                const int last = std::min(stride, cols - window_left);
+                for (int col = first; col < last; col++){
+                    target[col] = source[window_left + col];
+                }
+            }
+
+            const int last_row = top + height == rows ? height + 1 : height;
+            const int last_col = left + width == cols ? margin + width : margin + width - 1;
+            const long long euler = quad_euler(cells, stride, 1, last_row, margin, last_col);
+
+            DisjointSet& sets = scratch.sets;
+            std::vector<int>& labels = scratch.labels;
+            std::vector<size_t>& anchors = scratch.anchors;
+            std::vector<unsigned char>& touches = scratch.touches;
+            sets.reset();
+            labels.assign(cells.size(), -1);
+            anchors.clear();
+            touches.clear();
+            for (int row = 0; row < window_height; row++){
+                for (int col = 0; col < stride; col++){
+                    const size_t cell = static_cast<size_t>(row) * stride + col;
+                    if (cells[cell]) {
+                        continue;
+                    }
+                    int label = -1;
+                    const int neighbours[4] = {
+                        col > 0 ? labels[cell - 1] : -1,
+                        row > 0 && col > 0 ? labels[cell - stride - 1] : -1,
+                        row > 0 ? labels[cell - stride] : -1,
+                        row > 0 && col + 1 < stride ? labels[cell - stride + 1] : -1
+                    };
+                    for (int neighbour : neighbours){
+                        if (neighbour < 0) {
+                            continue;
+                        }
+                        if (label < 0) {
+                            label = neighbour;
+                        } else {
+                            const int first = sets.find(label);
+                            const int second = sets.find(neighbour);
+                            if (first != second) {
+                                sets.unite(first, second);
+                                const int root = sets.find(first);
+                                anchors[root] = std::min(anchors[first], anchors[second]);
+                                touches[root] = touches[first] | touches[second];
+                            }
+                        }
+                    }
+                    if (label < 0) {
+                        label = sets.make_set();
+                        anchors.push_back(cell);
+                        touches.push_back(0);
+                    }
+                    labels[cell] = label;
+                    if (row == 0 || col == 0 || row + 1 == window_height || col + 1 == stride) {
+                        touches[sets.find(label)] = 1;
+                    }
+                }
+            }
+
+            long long holes = 0;
+            for (size_t label = 0; label < sets.size(); label++){
+                if (sets.find(static_cast<int>(label)) != static_cast<int>(label) || touches[label]) {
+                    continue;
+                }
+                const int row = static_cast<int>(anchors[label] / stride);
+                const int col = static_cast<int>(anchors[label] % stride);
+                if (row >= 1 && row <= height && col >= margin && col < margin + width) {
+                    holes++;
+                }
+            }
+            return euler / 4.0 + holes;
+        }
+
+        // Two-sided standard normal quantile for a confidence level, by bisection on erf.
+        double normal_quantile(double confidence){
+            double low = 0.0, high = 10.0;
+            for (int iteration = 0; iteration < 100; iteration++){
+                const double middle = (low + high) / 2;
+                if (std::erf(middle / std::sqrt(2.0)) < confidence) {
+                    low = middle;
+                } else {
+                    high = middle;
+                }
+            }
+            return (low + high) / 2;
+        }
+
+        /**
+        * @brief Two-sided quantile of Student's t distribution for a confidence level.
+        *
+        * Cornish-Fisher expansion around the normal quantile (Abramowitz and Stegun 26.7.5); with
+        * the `PILOT_TILES - 1` degrees of freedom used here it is accurate to about 1e-5.
+        */
+        double student_quantile(double confidence, long long degrees){
+            const double z = normal_quantile(confidence);
+            const double z2 = z * z;
+            const double n = static_cast<double>(degrees);
+            return z + z * (z2 + 1) / (4 * n) +
+                z * ((5 * z2 + 16) * z2 + 3) / (96 * n * n) +
+                z * (((3 * z2 + 19) * z2 + 17) * z2 - 15) / (384 * n * n * n) +
+                z * ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) / (92160 * n * n * n * n);
+        }
+    }
+
+    /**
+    * @brief Estimates the number of clusters of a grid.
+    *
+    * Tiles are drawn without replacement with a sparse Fisher-Yates shuffle, so the sampling
+    * state grows with the number of sampled tiles only. The sample size follows Stein's
+    * two-stage procedure: the variance is estimated from `PILOT_TILES` tiles, the number of
+    * tiles that brings the half-width below `relative_error` times the estimate is computed
+    * from it, and exactly that many tiles are sampled, at most `max_sample_fraction` of them
+    * unless the pilot alone is more: the pilot is always sampled in full.
+    * The half-width uses the pilot variance, Student's t quantile for its degrees of freedom
+    * and the finite population correction. Stopping as soon as the interval of the tiles so
+    * far is narrow enough would favour samples whose variance happens to be low, and the
+    * interval would cover the count less often than its confidence.
+    *
+    * The count is estimated as the ratio of the sampled shares to the sampled cells, times the
+    * number of cells, and the variance is that of the residuals `share - ratio * area`. Partial
+    * tiles along the grid edges have a much smaller share than full ones; with the plain mean
+    * they would dominate the variance whenever the pilot contains some, and be missed by it
+    * otherwise. When every tile is sampled the interval collapses to the exact sum.
+    *
+    * @param grid The grid of boolean values representing cells to be checked for clusters.
+    * @param options The accuracy and time targets.
+    * @return The estimate and its confidence interval.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input` or an
+    *         option is out of range.
+    */
+    ApproximateCount ApproximateCounter::count_clusters(const std::vector<std::vector<bool>>& grid,
+                                                        const ApproximateOptions& options){
+        ClusterCounter::validate_input(grid);
+        if (options.tile_size <= 0 || options.hole_margin <= 0 || options.relative_error < 0 || options.confidence <= 0 ||
+            options.confidence >= 1 || options.max_sample_fraction <= 0 || options.max_sample_fraction > 1) {
+            throw std::invalid_argument("Approximate count options are out of range.");
+        }
+
+        const int rows = grid.size();
+        const int cols = grid[0].size();
+        const long long tile_rows = (rows + options.tile_size - 1) / options.tile_size;
+        const long long tile_cols = (cols + options.tile_size - 1) / options.tile_size;
+        const long long total = tile_rows * tile_cols;
+        const long long pilot = std::min(total, PILOT_TILES);
+        const long long budget = std::max(pilot, static_cast<long long>(std::ceil(options.max_sample_fraction * total)));
+
+        std::mt19937_64 generator(options.seed);
+        std::unordered_map<long long, long long> swapped;
+        TileScratch scratch;
+
+        ApproximateCount result;
+        result.confidence = options.confidence;
+        result.total_tiles = total;
+        // Sums over the sampled tiles of their shares and areas, for the ratio estimate
+        double shares = 0.0, areas = 0.0, share_squares = 0.0, area_squares = 0.0, products = 0.0;
+        long long sampled = 0;
+        // Draws tiles without replacement until `end` tiles are sampled
+        auto sample_until = [&](long long end){
+            for (; sampled < end; sampled++){
+                const long long pick = sampled + static_cast<long long>(generator() % (total - sampled));
+                const auto at_pick = swapped.find(pick);
+                const long long tile = at_pick == swapped.end() ? pick : at_pick->second;
+                const auto at_sampled = swapped.find(sampled);
+                swapped[pick] = at_sampled == swapped.end() ? sampled : at_sampled->second;
+
+                const int top = static_cast<int>(tile / tile_cols) * options.tile_size;
+                const int left = static_cast<int>(tile % tile_cols) * options.tile_size;
+                const double share = tile_share(grid, top, left, options.tile_size, options.hole_margin, scratch);
+                const double area = static_cast<double>(std::min(options.tile_size, rows - top)) *
+                    std::min(options.tile_size, cols - left);
+                shares += share;
+                areas += area;
+                share_squares += share * share;
+                area_squares += area * area;
+                products += share * area;
+            }
+        };
+        const double cells = static_cast<double>(rows) * cols;
+
+        sample_until(pilot);
+        // Variance of the residuals share - ratio * area over the pilot tiles
+        const double pilot_ratio = shares / areas;
+        const double variance = pilot > 1 ?
+            std::max(0.0, share_squares - 2 * pilot_ratio * products + pilot_ratio * pilot_ratio * area_squares) / (pilot - 1) : 0.0;
+        const double t = pilot > 1 ? student_quantile(options.confidence, pilot - 1) : 0.0;
+        const double target = options.relative_error * std::max(1.0, pilot_ratio * cells);
+        long long required = budget;
+        if (target > 0) {
+            // Smallest n with t * total * sqrt(variance / n * (1 - n / total)) <= target
+            const double unlimited = variance * (t * total / target) * (t * total / target);
+            required = static_cast<long long>(std::ceil(std::min(static_cast<double>(total), unlimited / (1.0 + unlimited / total))));
+        }
+        sample_until(std::min(budget, std::max(pilot, required)));
+
+        const double correction = 1.0 - static_cast<double>(sampled) / total;
+        const double half_width = t * total * std::sqrt(variance / sampled * correction);
+        result.sampled_tiles = sampled;
+        result.estimate = sampled == total ? shares : std::max(0.0, shares / areas * cells);
+        result.lower = std::max(0.0, result.estimate - half_width);
+        result.upper = result.estimate + half_width;
+        return result;
+    }
+}
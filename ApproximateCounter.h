@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+
+namespace clusters{
+
+    /**
+    * @struct ApproximateOptions
+    *
+    * @brief Accuracy and time targets of an approximate count.
+    */
+    struct ApproximateOptions{
+        int tile_size = 64;                 // side length of a sampled tile, in cells
+        int hole_margin = 32;               // cells around a tile searched for the end of its holes
+        double relative_error = 0.05;       // target half-width, as a fraction of the estimate, that sizes the second stage
+        double confidence = 0.95;           // confidence level of the interval
+        double max_sample_fraction = 0.05;  // time budget: fraction of the tiles sampled at most beyond the 64 pilot tiles
+        uint32_t seed = 0;                  // seed of the tile sampling, for reproducible estimates
+    };
+
+    /**
+    * @struct ApproximateCount
+    *
+    * @brief An estimated cluster count with its confidence interval.
+    */
+    struct ApproximateCount{
+        double estimate = 0.0;
+        double lower = 0.0;
+        double upper = 0.0;
+        double confidence = 0.0;
+        long long sampled_tiles = 0;
+        long long total_tiles = 0;
+    };
+
+    /**
+    * @class ApproximateCounter
+    *
+    * @brief Estimates the number of clusters from a random sample of tiles.
+    *
+    * The count is estimated through the Euler number: for 4-connected clusters, the number of
+    * clusters equals the Euler number plus the number of holes. The Euler number is a sum of
+    * local contributions of 2x2 cell patterns (bit-quads), so every tile owns an exact share of
+    * it, and the count is estimated as the sampled shares per cell times the number of cells,
+    * which weights the partial tiles along the grid edges by their area. Holes are counted from
+    * the sampled tiles as well: each hole belongs to the tile holding its first cell, and is
+    * found by labeling the background in a window reaching `hole_margin` cells past the tile.
+    * Holes extending further than the margin are missed, which biases the estimate downwards
+    * for images with very large holes. Tiles are sampled without replacement in two stages: a
+    * pilot sample estimates the variance of the shares, which fixes how many tiles are needed
+    * for the requested interval width within the time budget.
+    */
+    class ApproximateCounter{
+    public:
+
+        /**
+        * @brief Estimates the number of clusters of a grid.
+        *
+        * @param grid The grid of boolean values representing cells to be checked for clusters.
+        * @param options The accuracy and time targets.
+        * @return The estimate and its confidence interval.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input` or an
+        *         option is out of range.
+        */
+        static ApproximateCount count_clusters(const std::vector<std::vector<bool>>& grid,
+                                               const ApproximateOptions& options = ApproximateOptions());
+
+    private:
+
+        ApproximateCounter() = delete;
+    };
+}
@@ -0,0 +1,124 @@
+#include "BandSummary.h"
+#include <numeric>
+
+
+namespace clusters{
+    namespace{
+
+        /**
+        * @brief Unites the labels of overlapping runs of two adjacent rows.
+        *
+        * @return The number of successful unions.
+        */
+        int join_rows(DisjointSet& sets, const std::vector<Run>& upper, const std::vector<int>& upper_labels,
+                      const Run* lower, const int* lower_labels, size_t lower_count, int lower_base){
+            int unions = 0;
+            size_t above = 0;
+            size_t current = 0;
+            while (above < upper.size() && current < lower_count) {
+                if (upper[above].start < lower[current].end && lower[current].start < upper[above].end &&
+                    sets.unite(upper_labels[above], lower_base + lower_labels[current])) {
+                    unions++;
+                }
+                if (upper[above].end < lower[current].end) {
+                    above++;
+                } else {
+                    current++;
+                }
+            }
+            return unions;
+        }
+
+        // Replaces every label by the compact id of its set, numbering new sets from `next`.
+        void relabel(DisjointSet& sets, std::vector<int>& compact, std::vector<int>& labels, int base, int& next){
+            for (int& label : labels){
+                const int root = sets.find(base + label);
+                if (compact[root] < 0) {
+                    compact[root] = next++;
+                }
+                label = compact[root];
+            }
+        }
+    }
+
+    /**
+    * @brief Creates the summary of a single row, given its runs from left to right.
+    *
+    * @param runs The runs of the row.
+    * @param count The number of runs.
+    */
+    BandSummary::BandSummary(const Run* runs, size_t count)
+        : cluster_count(static_cast<int>(count)), row_count(1), label_count(static_cast<int>(count)),
+          top_runs(runs, runs + count), top_labels(count), bottom_runs(runs, runs + count), bottom_labels(count){
+        std::iota(top_labels.begin(), top_labels.end(), 0);
+        std::iota(bottom_labels.begin(), bottom_labels.end(), 0);
+    }
+
+    /**
+    * @brief Adds a row below the band, given its runs from left to right.
+    *
+    * The new row becomes the bottom row. Clusters of the old bottom row that neither reach the
+    * top row nor continue into the new row are complete and only stay in the count.
+    *
+    * @param runs The runs of the row.
+    * @param count The number of runs.
+    */
+    void BandSummary::append(const Run* runs, size_t count){
+        if (empty()) {
+            *this = BandSummary(runs, count);
+            return;
+        }
+
+        DisjointSet sets(label_count + count);
+        std::vector<int> new_labels(count);
+        std::iota(new_labels.begin(), new_labels.end(), 0);
+        const int unions = join_rows(sets, bottom_runs, bottom_labels, runs, new_labels.data(), count, label_count);
+        cluster_count += static_cast<int>(count) - unions;
+
+        std::vector<int> compact(sets.size(), -1);
+        int next = 0;
+        relabel(sets, compact, top_labels, 0, next);
+        relabel(sets, compact, new_labels, label_count, next);
+        label_count = next;
+        bottom_runs.assign(runs, runs + count);
+        bottom_labels.swap(new_labels);
+        row_count++;
+    }
+
+    /**
+    * @brief Joins two bands, the first directly above the second.
+    *
+    * Either band may be empty. The cost depends on the runs of the four boundary rows only.
+    *
+    * @param upper The upper band.
+    * @param lower The lower band.
+    * @return The summary of the combined band.
+    */
+    BandSummary BandSummary::merge(const BandSummary& upper, const BandSummary& lower){
+        if (upper.empty()) {
+            return lower;
+        }
+        if (lower.empty()) {
+            return upper;
+        }
+
+        DisjointSet sets(upper.label_count + lower.label_count);
+        const int unions = join_rows(sets, upper.bottom_runs, upper.bottom_labels, lower.top_runs.data(),
+                                     lower.top_labels.data(), lower.top_runs.size(), upper.label_count);
+
+        BandSummary result;
+        result.cluster_count = upper.cluster_count + lower.cluster_count - unions;
+        result.row_count = upper.row_count + lower.row_count;
+        result.top_runs = upper.top_runs;
+        result.top_labels = upper.top_labels;
+        result.bottom_runs = lower.bottom_runs;
+        result.bottom_labels = lower.bottom_labels;
+
+        std::vector<int> compact(sets.size(), -1);
+        int next = 0;
+        relabel(sets, compact, result.top_labels, 0, next);
+        relabel(sets, compact, result.bottom_labels, upper.label_count, next);
+        result.label_count = next;
+        return result;
+    }
+}
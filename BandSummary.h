@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "ScanKernels.h"
+#include "DisjointSet.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @class BandSummary
+    *
+    * @brief Cluster summary of a band of consecutive rows that can be joined with neighbouring bands.
+    *
+    * The summary holds the number of clusters inside the band together with the runs of its top
+    * and bottom rows, labeled by cluster. Clusters touching the top or bottom row share compact
+    * labels 0 .. labels-1, so a label appearing in both rows means the band connects them. Two
+    * summaries stacked on top of each other are joined by matching the bottom runs of the upper
+    * band with the top runs of the lower band, without looking at any interior row again.
+    */
+    class BandSummary{
+    public:
+
+        /**
+        * @brief Creates the summary of an empty band with no rows.
+        */
+        BandSummary() = default;
+
+        /**
+        * @brief Creates the summary of a single row, given its runs from left to right.
+        *
+        * @param runs The runs of the row.
+        * @param count The number of runs.
+        */
+        BandSummary(const Run* runs, size_t count);
+
+        /**
+        * @brief Adds a row below the band, given its runs from left to right.
+        *
+        * The cost depends on the runs of the new row and of the top row only.
+        *
+        * @param runs The runs of the row.
+        * @param count The number of runs.
+        */
+        void append(const Run* runs, size_t count);
+
+        /**
+        * @brief Joins two bands, the first directly above the second.
+        *
+        * Either band may be empty. The cost depends on the runs of the four boundary rows only.
+        *
+        * @param upper The upper band.
+        * @param lower The lower band.
+        * @return The summary of the combined band.
+        */
+        static BandSummary merge(const BandSummary& upper, const BandSummary& lower);
+
+        // @brief Returns the number of clusters in the band.
+        int clusters() const { return cluster_count; }
+
+        // @brief Returns the number of rows in the band.
+        int rows() const { return row_count; }
+
+        // @brief Returns true if the band has no rows.
+        bool empty() const { return row_count == 0; }
+
+    private:
+
+        int cluster_count = 0;
+        int row_count = 0;
+        int label_count = 0;
+        std::vector<Run> top_runs;
+        std::vector<int> top_labels;
+        std::vector<Run> bottom_runs;
+        std::vector<int> bottom_labels;
+    };
+}
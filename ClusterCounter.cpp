@@ -1,4 +1,6 @@
 #include "ClusterCounter.h"
+#include "RowMerger.h"
+#include "ScanKernels.h"
 #include <iostream>
 #include <queue>
 #include <stdexcept>
@@ -59,6 +61,68 @@ namespace clusters{
         return result;
     }
 
+    /**
+    * @brief Counts clusters of a bit-packed grid by merging the runs of consecutive rows.
+    * 
+    * Each row is split into runs of 'true' cells by the scan kernel selected for this CPU 
+    * (see `ScanKernels`), and runs of neighbouring rows are merged with a union-find structure 
+    * that only holds one row of labels. There is no BFS queue, so this method never throws 
+    * `QueueSizeExceededException`.
+    * 
+    * @param grid The packed grid of cells to be checked for clusters.
+    * @return The number of clusters found
+    */
+    int ClusterCounter::count_clusters(const PackedGrid& grid){
+        const ScanKernel& kernel = ScanKernels::active();
+        const size_t words = grid.words_per_row();
+        std::vector<Run> runs(words * PackedGrid::WORD_BITS / 2);
+        RowMerger merger;
+        for (int row = 0; row < grid.rows(); row++){
+            const size_t count = kernel.extract_runs(grid.row(row), words, runs.data());
+            merger.push(runs.data(), count);
+        }
+        return merger.clusters();
+    }
+
+    /**
+    * @brief Counts clusters of a bit-packed grid together with its perimeter, Euler number and holes.
+    * 
+    * Every row is merged into the clusters as in the packed `count_clusters`, and the bit-quads it 
+    * forms with the row above are counted while the row is in cache. The rows above the first 
+    * and below the last row are taken as 0, so the patterns on the border are counted as well. 
+    * With n1, n3 and nD the numbers of patterns with one cell, three cells and a diagonal pair, 
+    * and n2 the other patterns with two cells (Gray's bit-quad formulas, for 4-connected clusters): 
+    * Euler number = (n1 - n3 + 2 nD) / 4, perimeter = n1 + n2 + n3 + 2 nD, and since the Euler 
+    * number is the number of clusters minus the number of holes, holes = clusters - Euler number.
+    * 
+    * @param grid The packed grid of cells to be checked for clusters.
+    * @return The number of clusters with the perimeter, Euler number and number of holes.
+    */
+    GridStatistics ClusterCounter::count_statistics(const PackedGrid& grid){
+        const ScanKernel& kernel = ScanKernels::active();
+        const size_t words = grid.words_per_row();
+        std::vector<Run> runs(words * PackedGrid::WORD_BITS / 2);
+        const std::vector<uint64_t> empty(words, 0);
+        RowMerger merger;
+        QuadCounts quads;
+        const uint64_t* upper = empty.data();
+        for (int row = 0; row < grid.rows(); row++){
+            const size_t count = kernel.extract_runs(grid.row(row), words, runs.data());
+            merger.push(runs.data(), count);
+            kernel.count_quads(upper, grid.row(row), words, quads);
+            upper = grid.row(row);
+        }
+        kernel.count_quads(upper, empty.data(), words, quads);
+
+        const long long one = quads.one, two = quads.two, three = quads.three, diagonal = quads.diagonal;
+        GridStatistics result;
+        result.clusters = merger.clusters();
+        result.perimeter = one + two + three + 2 * diagonal;
+        result.euler_number = (one - three + 2 * diagonal) / 4;
+        result.holes = result.clusters - result.euler_number;
+        return result;
+    }
+
     /**
     * @brief Validates the input grid for proper dimensions and size constraints.
     * 
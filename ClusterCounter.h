@@ -1,6 +1,9 @@
+#pragma once
+
 #include <vector>
 #include <stdexcept>
 #include <queue>
+#include "PackedGrid.h"
 
 
 
@@ -30,6 +33,18 @@ namespace clusters{
         explicit QueueSizeExceededException(const std::string& message) : std::runtime_error(message) {}
     };
 
+    /**
+    * @struct GridStatistics
+    * 
+    * @brief Topological statistics of a grid, returned together with its cluster count.
+    */
+    struct GridStatistics{
+        int clusters = 0;
+        long long perimeter = 0;        // number of cell edges between a 'true' cell and a 'false' cell or the border
+        long long euler_number = 0;     // clusters minus holes
+        long long holes = 0;            // 8-connected regions of 'false' cells that do not reach the border
+    };
+
     /**
     * @class ClusterCounter
     * 
@@ -80,17 +95,38 @@ namespace clusters{
         * @return The number of clusters found
         */
         static int count_clusters(const std::vector<std::vector<bool>>& grid);
-
-    private: 
-        
-        ClusterCounter() = delete;
+        /**
+        * @brief Counts clusters of a bit-packed grid by merging the runs of consecutive rows.
+        * 
+        * Each row is split into runs of 'true' cells by the scan kernel selected for this CPU 
+        * (see `ScanKernels`), and runs of neighbouring rows are merged with a union-find structure 
+        * that only holds one row of labels. There is no BFS queue, so this method never throws 
+        * `QueueSizeExceededException`.
+        * 
+        * @param grid The packed grid of cells to be checked for clusters.
+        * @return The number of clusters found
+        */
+        static int count_clusters(const PackedGrid& grid);
+        /**
+        * @brief Counts clusters of a bit-packed grid together with its perimeter, Euler number and holes.
+        * 
+        * Works like the packed `count_clusters`, and in the same pass over the rows counts the 
+        * 2x2 cell patterns (bit-quads) of every pair of rows with the active scan kernel. The 
+        * perimeter and the Euler number follow from these counts, and the holes from the Euler 
+        * number and the cluster count.
+        * 
+        * @param grid The packed grid of cells to be checked for clusters.
+        * @return The number of clusters with the perimeter, Euler number and number of holes.
+        */
+        static GridStatistics count_statistics(const PackedGrid& grid);
 
         /**
         * @brief Validates the input grid for proper dimensions and size constraints.
         * 
         * This method checks if the grid is non-empty, if all rows have the same number of columns, 
         * and if the total number of cells does not exceed the maximum allowed limit. It throws 
-        * an exception if any validation fails.
+        * an exception if any validation fails. It is public so that the other engines in the 
+        * library apply exactly the same constraints as `count_clusters`.
         * 
         * @param grid The grid to be validated.
         * @throws std::invalid_argument If the grid is empty, rows have inconsistent column sizes, 
@@ -98,6 +134,10 @@ namespace clusters{
         */
         static void validate_input(const std::vector<std::vector<bool>>& grid);
 
+    private: 
+        
+        ClusterCounter() = delete;
+
         /**
         * @brief Traverses a cluster and marks all its connected cells as visited in the grid.
         * 
@@ -0,0 +1,85 @@
+#include "DisjointSet.h"
+#include <numeric>
+#include <utility>
+
+
+namespace clusters{
+    /**
+    * @brief Creates a structure holding `size` singleton sets with ids 0 .. size-1.
+    *
+    * @param size The number of initial singleton sets.
+    */
+    DisjointSet::DisjointSet(size_t size){
+        reset(size);
+    }
+
+    /**
+    * @brief Adds a new singleton set.
+    *
+    * @return The id of the new element.
+    */
+    int DisjointSet::make_set(){
+        const int id = static_cast<int>(parents.size());
+        parents.push_back(id);
+        ranks.push_back(0);
+        return id;
+    }
+
+    /**
+    * @brief Finds the representative of the set containing an element.
+    *
+    * Path halving links every visited element to its grandparent, which keeps the trees flat
+    * without a second pass or recursion.
+    *
+    * @param element The id of the element.
+    * @return The id of the set representative.
+    */
+    int DisjointSet::find(int element){
+        while (parents[element] != element) {
+            parents[element] = parents[parents[element]];
+            element = parents[element];
+        }
+        return element;
+    }
+
+    /**
+    * @brief Merges the sets containing two elements.
+    *
+    * @param first The id of the first element.
+    * @param second The id of the second element.
+    * @return True if the elements were in different sets and have been merged, false otherwise.
+    */
+    bool DisjointSet::unite(int first, int second){
+        first = find(first);
+        second = find(second);
+        if (first == second) {
+            return false;
+        }
+        if (ranks[first] < ranks[second]) {
+            std::swap(first, second);
+        }
+        parents[second] = first;
+        if (ranks[first] == ranks[second]) {
+            ranks[first]++;
+        }
+        return true;
+    }
+
+    /**
+    * @brief Removes all elements and creates `size` fresh singleton sets, keeping the allocation.
+    *
+    * @param size The number of singleton sets after the reset.
+    */
+    void DisjointSet::reset(size_t size){
+        parents.resize(size);
+        std::iota(parents.begin(), parents.end(), 0);
+        ranks.assign(size, 0);
+    }
+
+    /**
+    * @brief Returns the number of elements in the structure.
+    */
+    size_t DisjointSet::size() const{
+        return parents.size();
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+
+
+namespace clusters{
+
+    /**
+    * @class DisjointSet
+    *
+    * @brief Union-find structure over dense integer ids, used to merge provisional cluster labels.
+    *
+    * Elements are created with `make_set` and identified by consecutive integers starting at 0.
+    * `find` uses path halving and `unite` uses union by rank, so a sequence of operations runs in
+    * near-linear time. `unite` reports whether two distinct sets were merged, which lets callers
+    * count clusters as "labels created minus successful unions" without a final pass.
+    */
+    class DisjointSet{
+    public:
+
+        /**
+        * @brief Creates a structure holding `size` singleton sets with ids 0 .. size-1.
+        *
+        * @param size The number of initial singleton sets.
+        */
+        explicit DisjointSet(size_t size = 0);
+
+        /**
+        * @brief Adds a new singleton set.
+        *
+        * @return The id of the new element.
+        */
+        int make_set();
+
+        /**
+        * @brief Finds the representative of the set containing an element.
+        *
+        * @param element The id of the element.
+        * @return The id of the set representative.
+        */
+        int find(int element);
+
+        /**
+        * @brief Merges the sets containing two elements.
+        *
+        * @param first The id of the first element.
+        * @param second The id of the second element.
+        * @return True if the elements were in different sets and have been merged, false otherwise.
+        */
+        bool unite(int first, int second);
+
+        /**
+        * @brief Removes all elements and creates `size` fresh singleton sets, keeping the allocation.
+        *
+        * @param size The number of singleton sets after the reset.
+        */
+        void reset(size_t size = 0);
+
+        /**
+        * @brief Returns the number of elements in the structure.
+        */
+        size_t size() const;
+
+    private:
+
+        std::vector<int> parents;
+        std::vector<unsigned char> ranks;
+    };
+}
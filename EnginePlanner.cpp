@@ -0,0 +1,491 @@
+#include "EnginePlanner.h"
+#include "ClusterCounter.h"
+#include "PackedGrid.h"
+#include "ScanKernels.h"
+#include "RowMerger.h"
+#include "BandSummary.h"
+#include "DisjointSet.h"
+#include <algorithm>
+#include <exception>
+#include <queue>
+#include <string>
+#include <stdexcept>
+#include <thread>
+
+
+namespace clusters{
+    namespace{
+
+        using Grid = std::vector<std::vector<bool>>;
+
+        // Upper bound of the memory allocated by `count_streaming` for one row of `cols` cells.
+        size_t streaming_bytes(int cols){
+            const size_t words = (static_cast<size_t>(cols) + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+            const size_t runs = words * PackedGrid::WORD_BITS / 2;
+            return words * sizeof(uint64_t) + runs * (2 * sizeof(Run) + 2 * sizeof(int)) + 2 * runs * (sizeof(int) + 1);
+        }
+
+        // Upper bound of the memory allocated by `count_union_find` for one row of `cols` cells.
+        size_t union_find_bytes(int cols){
+            return static_cast<size_t>(cols) * (3 * sizeof(int) + 2 * (sizeof(int) + 1));
+        }
+
+        // Memory of a visited grid with the same shape as the input.
+        size_t bitmap_bytes(int rows, int cols){
+            const size_t words = (static_cast<size_t>(cols) + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+            return static_cast<size_t>(rows) * (words * sizeof(uint64_t) + sizeof(std::vector<bool>));
+        }
+
+        // Largest memory of the BFS queue before it throws.
+        size_t queue_bytes(){
+            return ClusterCounter::MAX_QUEUE_SIZE * sizeof(std::pair<int, int>);
+        }
+
+        // A band summary stores the runs of two rows, a band per thread plus the joined result.
+        size_t parallel_bytes(int cols, unsigned threads){
+            return threads * (streaming_bytes(cols) + 2 * streaming_bytes(cols));
+        }
+
+        /**
+        * @brief Labels the grid cell by cell, keeping the labels of the previous and the current row.
+        *
+        * Labels of the previous row are elements 0 .. previous_count-1 of the disjoint set; the
+        * cells of the current row either take the label of their upper or left neighbour or
+        * create a new one. After each row the labels are renumbered compactly.
+        *
+        * The cells listed in `joined`, in row-major order, count as a single cluster, as if they
+        * were all connected: every set remembers whether it holds one of them, and the sets that
+        * do are counted once.
+        */
+        int count_union_find(const Grid& grid, const std::vector<std::pair<int, int>>& joined = {}){
+            const int rows = grid.size();
+            const int cols = grid[0].size();
+            std::vector<int> previous(cols, -1);
+            std::vector<int> current(cols, -1);
+            std::vector<int> compact;
+            std::vector<unsigned char> holds_joined;
+            std::vector<unsigned char> compact_holds_joined;
+            DisjointSet sets;
+            int previous_count = 0;
+            int result = 0;
+            int joined_sets = 0;
+            size_t next_joined = 0;
+
+            for (int row = 0; row < rows; row++){
+                const auto& cells = grid[row];
+                sets.reset(previous_count);
+                holds_joined.assign(compact_holds_joined.begin(), compact_holds_joined.begin() + previous_count);
+                for (int col = 0; col < cols; col++){
+                    if (!cells[col]) {
+                        current[col] = -1;
+                        continue;
+                    }
+                    const int up = previous[col];
+                    const int back = col > 0 ? current[col - 1] : -1;
+                    if (back >= 0) {
+                        current[col] = back;
+                        if (up >= 0) {
+                            const int first = sets.find(up);
+                            const int second = sets.find(back);
+                            if (sets.unite(first, second)) {
+                                result--;
+                                joined_sets -= holds_joined[first] && holds_joined[second];
+                                holds_joined[sets.find(first)] = holds_joined[first] | holds_joined[second];
+                            }
+                        }
+                    } else if (up >= 0) {
+                        current[col] = up;
+                    } else {
+                        current[col] = sets.make_set();
+                        holds_joined.push_back(0);
+                        result++;
+                    }
+                    if (next_joined < joined.size() && joined[next_joined].first == row && joined[next_joined].second == col) {
+                        next_joined++;
+                        const int root = sets.find(current[col]);
+                        if (!holds_joined[root]) {
+                            holds_joined[root] = 1;
+                            joined_sets++;
+                        }
+                    }
+                }
+
+                compact.assign(sets.size(), -1);
+                compact_holds_joined.assign(sets.size(), 0);
+                previous_count = 0;
+                for (int col = 0; col < cols; col++){
+                    if (current[col] >= 0) {
+                        const int root = sets.find(current[col]);
+                        if (compact[root] < 0) {
+                            compact_holds_joined[previous_count] = holds_joined[root];
+                            compact[root] = previous_count++;
+                        }
+                        current[col] = compact[root];
+                    }
+                }
+                previous.swap(current);
+            }
+            return joined_sets > 1 ? result - (joined_sets - 1) : result;
+        }
+
+        /**
+        * @brief Counts clusters with a BFS that clears the grid, finishing with union-find if its queue overflows.
+        *
+        * The BFS marks cells by clearing them, as `ClusterCounter::count_clusters(grid&)` does. When
+        * the queue grows past `ClusterCounter::MAX_QUEUE_SIZE`, the queued cells are set again. Every
+        * cell of the interrupted cluster that is still set is connected to one of them, because the
+        * cells taken out of the queue had all their neighbours queued. The clusters left in the grid
+        * are then counted with union-find, with all the queued cells counted as one cluster.
+        *
+        * @param grid The grid to be counted; its contents are unspecified afterwards.
+        * @param overflowed Set to true if the queue overflowed.
+        */
+        int count_in_place(Grid& grid, bool& overflowed){
+            const int rows = grid.size();
+            const int cols = grid[0].size();
+            std::queue<std::pair<int, int>> waiting;
+            int result = 0;
+            for (int start_row = 0; start_row < rows; start_row++){
+                for (int start_col = 0; start_col < cols; start_col++){
+                    if (!grid[start_row][start_col]) {
+                        continue;
+                    }
+                    grid[start_row][start_col] = 0;
+                    waiting.push({start_row, start_col});
+                    while (!waiting.empty()) {
+                        if (waiting.size() > ClusterCounter::MAX_QUEUE_SIZE) {
+                            std::vector<std::pair<int, int>> queued;
+                            queued.reserve(waiting.size());
+                            for (; !waiting.empty(); waiting.pop()){
+                                grid[waiting.front().first][waiting.front().second] = 1;
+                                queued.push_back(waiting.front());
+                            }
+                            std::sort(queued.begin(), queued.end());
+                            overflowed = true;
+                            return result + count_union_find(grid, queued);
+                        }
+                        const auto [row, col] = waiting.front();
+                        waiting.pop();
+                        for (int delta = 0; delta < ClusterCounter::deltas_number; delta++){
+                            const int new_row = row + ClusterCounter::row_deltas[delta];
+                            const int new_col = col + ClusterCounter::col_deltas[delta];
+                            if (0 <= new_row && new_row < rows && 0 <= new_col && new_col < cols && grid[new_row][new_col]) {
+                                grid[new_row][new_col] = 0;
+                                waiting.push({new_row, new_col});
+                            }
+                        }
+                    }
+                    result++;
+                }
+            }
+            return result;
+        }
+
+        /**
+        * @brief Packs one row at a time and merges the runs extracted by the active scan kernel.
+        */
+        int count_streaming(const Grid& grid){
+            const ScanKernel& kernel = ScanKernels::active();
+            const size_t words = (grid[0].size() + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+            std::vector<uint64_t> packed(words);
+            std::vector<Run> runs(words * PackedGrid::WORD_BITS / 2);
+            RowMerger merger;
+            for (const auto& row : grid){
+                PackedGrid::pack_row(row, packed.data());
+                merger.push(runs.data(), kernel.extract_runs(packed.data(), words, runs.data()));
+            }
+            return merger.clusters();
+        }
+
+        /**
+        * @brief Splits the rows into one band per thread, summarizes the bands concurrently and
+        * joins the summaries from top to bottom.
+        */
+        int count_parallel(const Grid& grid, unsigned threads){
+            const int rows = grid.size();
+            const int bands = static_cast<int>(std::min<unsigned>(threads, rows));
+            const size_t words = (grid[0].size() + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+            std::vector<BandSummary> summaries(bands);
+            std::vector<std::exception_ptr> errors(bands);
+
+            auto summarize = [&](int band){
+                try {
+                    const ScanKernel& kernel = ScanKernels::active();
+                    std::vector<uint64_t> packed(words);
+                    std::vector<Run> runs(words * PackedGrid::WORD_BITS / 2);
+                    const int first = static_cast<int>(static_cast<long long>(rows) * band / bands);
+                    const int last = static_cast<int>(static_cast<long long>(rows) * (band + 1) / bands);
+                    for (int row = first; row < last; row++){
+                        PackedGrid::pack_row(grid[row], packed.data());
+                        summaries[band].append(runs.data(), kernel.extract_runs(packed.data(), words, runs.data()));
+                    }
+                } catch (...) {
+                    errors[band] = std::current_exception();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (int band = 1; band < bands; band++){
+                workers.emplace_back(summarize, band);
+            }
+            summarize(0);
+            for (auto& worker : workers){
+                worker.join();
+            }
+            for (const auto& error : errors){
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            BandSummary result;
+            for (const auto& summary : summaries){
+                result = BandSummary::merge(result, summary);
+            }
+            return result.clusters();
+        }
+
+        unsigned available_threads(unsigned threads){
+            if (threads == 0) {
+                threads = std::thread::hardware_concurrency();
+            }
+            return std::max(1u, threads);
+        }
+
+        // Records in a plan that the BFS queue overflowed and which engine finished the count.
+        void report_overflow(Plan& plan, Strategy strategy, size_t bytes){
+            plan.strategy = strategy;
+            plan.estimated_bytes = bytes;
+            plan.reason += "; the BFS queue exceeded " + std::to_string(ClusterCounter::MAX_QUEUE_SIZE) +
+                " cells, so the count was finished with " + EnginePlanner::name(strategy);
+        }
+
+        /**
+        * @brief Runs a plan on a grid that must not be modified, updating the plan if the BFS queue overflows.
+        */
+        int run(Plan& plan, const Grid& grid){
+            ClusterCounter::validate_input(grid);
+            switch (plan.strategy) {
+                case Strategy::InPlaceTraversal:
+                    throw std::invalid_argument("In-place traversal needs a grid that may be modified.");
+                case Strategy::VisitedTraversal:
+                    try {
+                        return ClusterCounter::count_clusters(grid);
+                    } catch (const QueueSizeExceededException&) {
+                        report_overflow(plan, Strategy::Streaming, bitmap_bytes(grid.size(), grid[0].size()) + queue_bytes());
+                        return count_streaming(grid);
+                    }
+                case Strategy::UnionFind:
+                    return count_union_find(grid);
+                case Strategy::ParallelTiles:
+                    return count_parallel(grid, available_threads(plan.threads));
+                case Strategy::Streaming:
+                default:
+                    return count_streaming(grid);
+            }
+        }
+
+        /**
+        * @brief Runs a plan on a grid that may be modified, updating the plan if the BFS queue overflows.
+        */
+        int run(Plan& plan, Grid& grid){
+            if (plan.strategy != Strategy::InPlaceTraversal) {
+                return run(plan, static_cast<const Grid&>(grid));
+            }
+            ClusterCounter::validate_input(grid);
+            bool overflowed = false;
+            const int result = count_in_place(grid, overflowed);
+            if (overflowed) {
+                report_overflow(plan, Strategy::UnionFind, queue_bytes() + union_find_bytes(grid[0].size()));
+            }
+            return result;
+        }
+    }
+
+    /**
+    * @brief Samples the grid to estimate its density and run statistics.
+    *
+    * At most `SAMPLE_ROWS` evenly spaced rows are read, and at most `SAMPLE_COLS` cells of each.
+    * The sampled window is shifted from row to row so that a narrow feature is not missed in
+    * every row.
+    *
+    * @param grid The grid to be profiled.
+    * @return The profile of the grid.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+    */
+    GridProfile EnginePlanner::profile(const std::vector<std::vector<bool>>& grid){
+        ClusterCounter::validate_input(grid);
+
+        GridProfile result;
+        result.rows = grid.size();
+        result.cols = grid[0].size();
+
+        const int samples = std::min(result.rows, SAMPLE_ROWS);
+        const int width = std::min(result.cols, SAMPLE_COLS);
+        long long ones = 0;
+        long long runs = 0;
+        for (int sample = 0; sample < samples; sample++){
+            const int row = static_cast<int>((2LL * sample + 1) * result.rows / (2LL * samples));
+            const int first = static_cast<int>((sample * 2654435761ULL) % (result.cols - width + 1));
+            const auto& cells = grid[row];
+            bool previous = false;
+            for (int col = first; col < first + width; col++){
+                const bool cell = cells[col];
+                ones += cell;
+                runs += cell && !previous;
+                previous = cell;
+            }
+        }
+        result.sampled_cells = static_cast<long long>(samples) * width;
+        result.density = static_cast<double>(ones) / result.sampled_cells;
+        result.mean_run_length = runs > 0 ? static_cast<double>(ones) / runs : 0.0;
+        return result;
+    }
+
+    /**
+    * @brief Chooses an engine for a grid.
+    *
+    * The candidates are tried from the fastest to the most frugal, and the first one whose
+    * memory estimate fits in the budget is chosen. If no engine fits in the budget, the engine
+    * using the least memory is chosen and the reason says so.
+    *
+    * @param grid The grid to be counted.
+    * @param may_modify True if the engine is allowed to modify the grid.
+    * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+    * @param threads The number of threads available, 0 for the hardware concurrency.
+    * @return The chosen plan.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+    */
+    Plan EnginePlanner::plan(const std::vector<std::vector<bool>>& grid, bool may_modify,
+                             size_t memory_budget, unsigned threads){
+        Plan result;
+        result.profile = profile(grid);
+        const GridProfile& profile = result.profile;
+        const long long cells = static_cast<long long>(profile.rows) * profile.cols;
+        threads = available_threads(threads);
+
+        auto choose = [&](Strategy strategy, size_t bytes, unsigned used_threads, const std::string& reason){
+            if (bytes > memory_budget) {
+                return false;
+            }
+            result.strategy = strategy;
+            result.estimated_bytes = bytes;
+            result.threads = used_threads;
+            result.reason = reason;
+            return true;
+        };
+
+        if (cells >= PARALLEL_MIN_CELLS && threads > 1 && profile.rows >= 2 * static_cast<long long>(threads) &&
+            choose(Strategy::ParallelTiles, parallel_bytes(profile.cols, threads), threads,
+                   std::to_string(cells) + " cells split into " + std::to_string(threads) + " bands counted in parallel")) {
+            return result;
+        }
+
+        const bool bfs_safe = 2LL * (profile.rows + profile.cols) <= static_cast<long long>(ClusterCounter::MAX_QUEUE_SIZE);
+        if (profile.density <= SPARSE_DENSITY && bfs_safe) {
+            const std::string reason = "sparse grid (density " + std::to_string(profile.density) + "), BFS only expands the set cells";
+            if (may_modify && choose(Strategy::InPlaceTraversal, queue_bytes(), 1, reason)) {
+                return result;
+            }
+            if (choose(Strategy::VisitedTraversal, bitmap_bytes(profile.rows, profile.cols) + queue_bytes(), 1, reason)) {
+                return result;
+            }
+        }
+
+        if (profile.density <= MODERATE_DENSITY && profile.mean_run_length >= LONG_RUN_LENGTH &&
+            choose(Strategy::UnionFind, union_find_bytes(profile.cols), 1,
+                   "few long runs (density " + std::to_string(profile.density) + ", mean run length " +
+                   std::to_string(profile.mean_run_length) + "), labeling cell by cell")) {
+            return result;
+        }
+
+        if (choose(Strategy::Streaming, streaming_bytes(profile.cols), 1,
+                   "density " + std::to_string(profile.density) + ", mean run length " + std::to_string(profile.mean_run_length) +
+                   ", streaming rows through the " + ScanKernels::active().name + " scan kernel")) {
+            return result;
+        }
+
+        const bool union_find_smaller = union_find_bytes(profile.cols) < streaming_bytes(profile.cols);
+        result.strategy = union_find_smaller ? Strategy::UnionFind : Strategy::Streaming;
+        result.estimated_bytes = std::min(union_find_bytes(profile.cols), streaming_bytes(profile.cols));
+        result.threads = 1;
+        result.reason = "no engine fits in the memory budget of " + std::to_string(memory_budget) + " bytes, using the smallest one";
+        return result;
+    }
+
+    /**
+    * @brief Counts clusters with an automatically chosen engine, allowing the grid to be modified.
+    *
+    * @param grid The grid to be counted.
+    * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+    * @param threads The number of threads available, 0 for the hardware concurrency.
+    * @return The number of clusters and the plan used.
+    */
+    PlannedCount EnginePlanner::count_clusters(std::vector<std::vector<bool>>& grid,
+                                               size_t memory_budget, unsigned threads){
+        PlannedCount result;
+        result.plan = plan(grid, true, memory_budget, threads);
+        result.clusters = run(result.plan, grid);
+        return result;
+    }
+
+    /**
+    * @brief Counts clusters with an automatically chosen engine, leaving the grid unchanged.
+    *
+    * @param grid The grid to be counted.
+    * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+    * @param threads The number of threads available, 0 for the hardware concurrency.
+    * @return The number of clusters and the plan used.
+    */
+    PlannedCount EnginePlanner::count_clusters(const std::vector<std::vector<bool>>& grid,
+                                               size_t memory_budget, unsigned threads){
+        PlannedCount result;
+        result.plan = plan(grid, false, memory_budget, threads);
+        result.clusters = run(result.plan, grid);
+        return result;
+    }
+
+    /**
+    * @brief Runs a plan on a grid that must not be modified.
+    *
+    * If the plan is a visited traversal and its queue overflows, the count is finished by streaming.
+    *
+    * @param plan The plan to be run.
+    * @param grid The grid to be counted.
+    * @return The number of clusters found.
+    * @throws std::invalid_argument If the plan asks to modify the grid.
+    */
+    int EnginePlanner::execute(const Plan& plan, const std::vector<std::vector<bool>>& grid){
+        Plan used = plan;
+        return run(used, grid);
+    }
+
+    /**
+    * @brief Runs a plan on a grid that may be modified.
+    *
+    * If the plan is a traversal and its queue overflows, the count is finished by union-find
+    * (in place) or streaming (visited).
+    *
+    * @param plan The plan to be run.
+    * @param grid The grid to be counted.
+    * @return The number of clusters found.
+    */
+    int EnginePlanner::execute(const Plan& plan, std::vector<std::vector<bool>>& grid){
+        Plan used = plan;
+        return run(used, grid);
+    }
+
+    /**
+    * @brief Returns a readable name for a strategy.
+    */
+    const char* EnginePlanner::name(Strategy strategy){
+        switch (strategy) {
+            case Strategy::InPlaceTraversal: return "in-place traversal";
+            case Strategy::VisitedTraversal: return "visited traversal";
+            case Strategy::UnionFind: return "union-find";
+            case Strategy::ParallelTiles: return "parallel tiles";
+            case Strategy::Streaming: return "streaming";
+        }
+        return "unknown";
+    }
+}
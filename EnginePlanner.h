@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+
+
+namespace clusters{
+
+    /**
+    * @enum Strategy
+    *
+    * @brief The counting engines the planner can choose from.
+    */
+    enum class Strategy{
+        InPlaceTraversal,   // BFS that clears the input grid, `ClusterCounter::count_clusters(grid&)`
+        VisitedTraversal,   // BFS with a visited bitmap, `ClusterCounter::count_clusters(const grid&)`
+        UnionFind,          // cell-by-cell labeling with a union-find over two rows of labels
+        ParallelTiles,      // bands of rows counted on several threads and joined at their borders
+        Streaming           // rows packed one at a time and merged as runs by the scan kernels
+    };
+
+    /**
+    * @struct GridProfile
+    *
+    * @brief Statistics gathered from a sample of the grid.
+    */
+    struct GridProfile{
+        int rows = 0;
+        int cols = 0;
+        long long sampled_cells = 0;
+        double density = 0.0;           // fraction of sampled cells that are 'true'
+        double mean_run_length = 0.0;   // average length of the horizontal runs in the sample
+    };
+
+    /**
+    * @struct Plan
+    *
+    * @brief The engine chosen for a grid, and why.
+    */
+    struct Plan{
+        Strategy strategy = Strategy::Streaming;
+        GridProfile profile;
+        size_t estimated_bytes = 0;     // extra memory the engine is expected to allocate
+        unsigned threads = 1;
+        std::string reason;
+    };
+
+    /**
+    * @struct PlannedCount
+    *
+    * @brief Result of an automatic count: the number of clusters and the plan that produced it.
+    */
+    struct PlannedCount{
+        int clusters = 0;
+        Plan plan;
+    };
+
+    /**
+    * @class EnginePlanner
+    *
+    * @brief Chooses and runs a counting engine from the shape, density and memory budget of a grid.
+    *
+    * The planner samples a few rows to estimate the density and the average run length, then
+    * picks the fastest engine whose memory estimate fits in the caller's budget:
+    *
+    * - large grids are split into bands counted in parallel when more than one thread is available;
+    * - sparse grids are traversed with BFS, in place when the caller allows the grid to be
+    *   modified and with a visited bitmap otherwise;
+    * - moderately sparse grids with long runs are labeled cell by cell with a union-find, which
+    *   only copies the left label along a run;
+    * - all other grids, and any grid under a tight budget, are streamed row by row through the
+    *   vectorized scan kernels, which needs memory for a single row only.
+    *
+    * BFS is only chosen when twice the perimeter of the grid fits in `ClusterCounter::MAX_QUEUE_SIZE`,
+    * which bounds the queue for compact clusters but not for branching ones. If the queue grows
+    * past that size, the count is finished by union-find (in place) or streaming (visited) instead
+    * of throwing, and the plan returned by `count_clusters` reports the engine that finished it.
+    */
+    class EnginePlanner{
+    public:
+
+        // @constant UNLIMITED_MEMORY Budget value meaning that memory use is not limited.
+        static constexpr size_t UNLIMITED_MEMORY = SIZE_MAX;
+
+        // @constant SAMPLE_ROWS Maximum number of rows sampled by `profile`.
+        static constexpr int SAMPLE_ROWS = 64;
+
+        // @constant SAMPLE_COLS Maximum number of consecutive cells sampled in each sampled row.
+        static constexpr int SAMPLE_COLS = 4096;
+
+        // @constant SPARSE_DENSITY Density up to which a BFS traversal is preferred.
+        static constexpr double SPARSE_DENSITY = 0.05;
+
+        // @constant MODERATE_DENSITY Density up to which cell-by-cell union-find may be preferred to streaming.
+        static constexpr double MODERATE_DENSITY = 0.15;
+
+        // @constant LONG_RUN_LENGTH Mean run length from which cell-by-cell union-find may be preferred to streaming.
+        static constexpr double LONG_RUN_LENGTH = 4.0;
+
+        // @constant PARALLEL_MIN_CELLS Number of cells from which counting in parallel pays off.
+        static constexpr long long PARALLEL_MIN_CELLS = 1LL << 22;
+
+        /**
+        * @brief Samples the grid to estimate its density and run statistics.
+        *
+        * At most `SAMPLE_ROWS` evenly spaced rows are read, and at most `SAMPLE_COLS` cells of each.
+        *
+        * @param grid The grid to be profiled.
+        * @return The profile of the grid.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+        */
+        static GridProfile profile(const std::vector<std::vector<bool>>& grid);
+
+        /**
+        * @brief Chooses an engine for a grid.
+        *
+        * If no engine fits in the budget, the engine using the least memory is chosen and the
+        * reason says so.
+        *
+        * @param grid The grid to be counted.
+        * @param may_modify True if the engine is allowed to modify the grid.
+        * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+        * @param threads The number of threads available, 0 for the hardware concurrency.
+        * @return The chosen plan.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+        */
+        static Plan plan(const std::vector<std::vector<bool>>& grid, bool may_modify,
+                         size_t memory_budget = UNLIMITED_MEMORY, unsigned threads = 0);
+
+        /**
+        * @brief Counts clusters with an automatically chosen engine, allowing the grid to be modified.
+        *
+        * As with `ClusterCounter::count_clusters(grid&)`, the contents of the grid are unspecified
+        * afterwards.
+        *
+        * @param grid The grid to be counted.
+        * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+        * @param threads The number of threads available, 0 for the hardware concurrency.
+        * @return The number of clusters and the plan used.
+        */
+        static PlannedCount count_clusters(std::vector<std::vector<bool>>& grid,
+                                           size_t memory_budget = UNLIMITED_MEMORY, unsigned threads = 0);
+
+        /**
+        * @brief Counts clusters with an automatically chosen engine, leaving the grid unchanged.
+        *
+        * @param grid The grid to be counted.
+        * @param memory_budget The maximum extra memory, in bytes, the engine should allocate.
+        * @param threads The number of threads available, 0 for the hardware concurrency.
+        * @return The number of clusters and the plan used.
+        */
+        static PlannedCount count_clusters(const std::vector<std::vector<bool>>& grid,
+                                           size_t memory_budget = UNLIMITED_MEMORY, unsigned threads = 0);
+
+        /**
+        * @brief Runs a plan on a grid.
+        *
+        * If the plan is a traversal and its queue overflows, the count is finished by union-find
+        * (in place) or streaming (visited).
+        *
+        * @param plan The plan to be run. `InPlaceTraversal` is only allowed with a modifiable grid.
+        * @param grid The grid to be counted.
+        * @return The number of clusters found.
+        * @throws std::invalid_argument If the plan asks to modify a grid that is not modifiable.
+        */
+        static int execute(const Plan& plan, const std::vector<std::vector<bool>>& grid);
+        static int execute(const Plan& plan, std::vector<std::vector<bool>>& grid);
+
+        /**
+        * @brief Returns a readable name for a strategy.
+        */
+        static const char* name(Strategy strategy);
+
+    private:
+
+        EnginePlanner() = delete;
+    };
+}
@@ -0,0 +1,275 @@
+#include "GridReader.h"
+#include "ClusterCounter.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+
+
+namespace clusters{
+    namespace{
+
+        // Byte with its bit order reversed: PBM stores the leftmost pixel in the highest bit.
+        constexpr std::array<uint8_t, 256> make_reversed_bytes(){
+            std::array<uint8_t, 256> table{};
+            for (int byte = 0; byte < 256; byte++){
+                int reversed = 0;
+                for (int bit = 0; bit < 8; bit++){
+                    reversed |= ((byte >> bit) & 1) << (7 - bit);
+                }
+                table[byte] = static_cast<uint8_t>(reversed);
+            }
+            return table;
+        }
+
+        constexpr std::array<uint8_t, 256> REVERSED_BYTES = make_reversed_bytes();
+
+        std::runtime_error invalid_file(GridFormat format, const std::string& path){
+            return std::runtime_error(std::string("Not a ") + GridReader::name(format) + " grid file: " + path + ".");
+        }
+
+        // Mask of the bits of the last word of a row that hold cells.
+        uint64_t last_word_mask(int cols){
+            const int used = cols % PackedGrid::WORD_BITS;
+            return used == 0 ? ~uint64_t(0) : (uint64_t(1) << used) - 1;
+        }
+
+        bool is_blank(char character){
+            return character == ' ' || character == '\t' || character == '\n' || character == '\r' ||
+                character == '\v' || character == '\f';
+        }
+
+        // Skips blanks and '#' comments of a PBM file.
+        void skip_pbm_blanks(const std::string& data, size_t& position){
+            while (position < data.size()) {
+                if (data[position] == '#') {
+                    while (position < data.size() && data[position] != '\n') {
+                        position++;
+                    }
+                } else if (is_blank(data[position])) {
+                    position++;
+                } else {
+                    return;
+                }
+            }
+        }
+
+        // Reads a positive decimal number of a PBM header, or returns -1.
+        int read_pbm_number(const std::string& data, size_t& position){
+            skip_pbm_blanks(data, position);
+            long long value = 0;
+            const size_t start = position;
+            while (position < data.size() && data[position] >= '0' && data[position] <= '9' && value <= INT_MAX) {
+                value = value * 10 + (data[position] - '0');
+                position++;
+            }
+            if (position == start || value <= 0 || value > INT_MAX) {
+                return -1;
+            }
+            return static_cast<int>(value);
+        }
+    }
+
+    /**
+    * @brief Reads a grid file.
+    *
+    * The whole file is read into memory with a single call and parsed from there. Only regular
+    * files are read, and their size is known before anything is allocated.
+    *
+    * @param path The path of the file.
+    * @param format The format of the file.
+    * @param rows The number of rows of a raw file; ignored for other formats.
+    * @param cols The number of columns of a raw file; ignored for other formats.
+    * @return The packed grid.
+    * @throws std::runtime_error If the file cannot be read or is not a valid file of the format.
+    * @throws std::invalid_argument If the grid is empty, too large or has rows of different lengths.
+    */
+    PackedGrid GridReader::read(const std::string& path, GridFormat format, int rows, int cols){
+        struct stat status;
+        if (::stat(path.c_str(), &status) != 0) {
+            throw std::runtime_error("Cannot open grid file: " + path + " (" + std::strerror(errno) + ").");
+        }
+        std::string data;
+        if (!S_ISREG(status.st_mode) || static_cast<unsigned long long>(status.st_size) > data.max_size()) {
+            throw std::runtime_error("Cannot read grid file: " + path + ".");
+        }
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Cannot open grid file: " + path + " (" + std::strerror(errno) + ").");
+        }
+        data.resize(static_cast<size_t>(status.st_size));
+        if (!file.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+            throw std::runtime_error("Cannot read grid file: " + path + ".");
+        }
+
+        if (format == GridFormat::Auto) {
+            const bool pbm = data.size() > 2 && data[0] == 'P' && (data[1] == '1' || data[1] == '4') && is_blank(data[2]);
+            format = pbm ? GridFormat::Pbm : GridFormat::Text;
+        }
+        switch (format) {
+            case GridFormat::Pbm: return parse_pbm(data, path);
+            case GridFormat::Raw: return parse_raw(data, path, rows, cols);
+            default: return parse_text(data, path);
+        }
+    }
+
+    /**
+    * @brief Returns the name of a format: "auto", "pbm", "text" or "raw".
+    */
+    const char* GridReader::name(GridFormat format){
+        switch (format) {
+            case GridFormat::Auto: return "auto";
+            case GridFormat::Pbm: return "pbm";
+            case GridFormat::Text: return "text";
+            case GridFormat::Raw: return "raw";
+        }
+        return "unknown";
+    }
+
+    /**
+    * @brief Parses a plain (P1) or binary (P4) portable bitmap.
+    *
+    * Binary rows are padded to whole bytes with the leftmost pixel in the highest bit; each byte
+    * is reversed through a table and eight of them are assembled into a word.
+    */
+    PackedGrid GridReader::parse_pbm(const std::string& data, const std::string& path){
+        if (data.size() < 2 || data[0] != 'P' || (data[1] != '1' && data[1] != '4')) {
+            throw invalid_file(GridFormat::Pbm, path);
+        }
+        const bool binary = data[1] == '4';
+        size_t position = 2;
+        const int cols = read_pbm_number(data, position);
+        const int rows = read_pbm_number(data, position);
+        if (cols < 0 || rows < 0 || position >= data.size() || !is_blank(data[position])) {
+            throw invalid_file(GridFormat::Pbm, path);
+        }
+        position++;
+        // The header is untrusted: reject a payload too short for it before allocating the grid.
+        // A binary row takes whole bytes, and every plain cell at least one character.
+        const size_t bytes_per_row = (static_cast<size_t>(cols) + 7) / 8;
+        const size_t remaining = data.size() - position;
+        if (binary ? bytes_per_row > 0 && remaining / bytes_per_row < static_cast<size_t>(rows)
+                   : remaining < static_cast<size_t>(rows) * static_cast<size_t>(cols)) {
+            throw invalid_file(GridFormat::Pbm, path);
+        }
+
+        PackedGrid grid(rows, cols);
+        const size_t words = grid.words_per_row();
+        const uint64_t mask = last_word_mask(cols);
+        if (binary) {
+            for (int row = 0; row < rows; row++){
+                const unsigned char* source = reinterpret_cast<const unsigned char*>(data.data()) + position +
+                    static_cast<size_t>(row) * bytes_per_row;
+                uint64_t* target = grid.row(row);
+                for (size_t word = 0; word < words; word++){
+                    const size_t first = word * 8;
+                    const size_t last = std::min(bytes_per_row, first + 8);
+                    uint64_t value = 0;
+                    for (size_t byte = first; byte < last; byte++){
+                        value |= uint64_t(REVERSED_BYTES[source[byte]]) << (8 * (byte - first));
+                    }
+                    target[word] = value;
+                }
+                target[words - 1] &= mask;
+            }
+        } else {
+            for (int row = 0; row < rows; row++){
+                uint64_t* target = grid.row(row);
+                for (int col = 0; col < cols; col++){
+                    skip_pbm_blanks(data, position);
+                    if (position >= data.size() || (data[position] != '0' && data[position] != '1')) {
+                        throw invalid_file(GridFormat::Pbm, path);
+                    }
+                    target[col / PackedGrid::WORD_BITS] |= uint64_t(data[position] - '0') << (col % PackedGrid::WORD_BITS);
+                    position++;
+                }
+            }
+        }
+        return grid;
+    }
+
+    /**
+    * @brief Parses a text grid: one row per line of '0' and '1' characters.
+    *
+    * Blanks and commas between cells are ignored, and lines without cells are skipped. A first
+    * pass finds the rows and checks their lengths, a second one packs the cells.
+    */
+    PackedGrid GridReader::parse_text(const std::string& data, const std::string& path){
+        std::vector<std::pair<size_t, size_t>> lines;
+        size_t cols = 0;
+        size_t start = 0;
+        while (start < data.size()) {
+            size_t end = data.find('\n', start);
+            if (end == std::string::npos) {
+                end = data.size();
+            }
+            size_t cells = 0;
+            for (size_t position = start; position < end; position++){
+                const char character = data[position];
+                if (character == '0' || character == '1') {
+                    cells++;
+                } else if (!is_blank(character) && character != ',') {
+                    throw invalid_file(GridFormat::Text, path);
+                }
+            }
+            if (cells > 0) {
+                if (lines.empty()) {
+                    cols = cells;
+                } else if (cells != cols) {
+                    throw std::invalid_argument("All rows in the grid must have the same number of cells.");
+                }
+                lines.emplace_back(start, end);
+            }
+            start = end + 1;
+        }
+        if (cols > static_cast<size_t>(ClusterCounter::MAX_CELLS) || lines.size() > static_cast<size_t>(ClusterCounter::MAX_CELLS)) {
+            throw std::invalid_argument("The number of cells exceeds 2^31 (maximum allowed cells).");
+        }
+
+        PackedGrid grid(static_cast<int>(lines.size()), static_cast<int>(cols));
+        for (size_t row = 0; row < lines.size(); row++){
+            uint64_t* target = grid.row(static_cast<int>(row));
+            size_t col = 0;
+            for (size_t position = lines[row].first; position < lines[row].second; position++){
+                const char character = data[position];
+                if (character == '0' || character == '1') {
+                    target[col / PackedGrid::WORD_BITS] |= uint64_t(character - '0') << (col % PackedGrid::WORD_BITS);
+                    col++;
+                }
+            }
+        }
+        return grid;
+    }
+
+    /**
+    * @brief Parses a raw grid: the words of `PackedGrid`, little-endian, without a header.
+    */
+    PackedGrid GridReader::parse_raw(const std::string& data, const std::string& path, int rows, int cols){
+        PackedGrid grid(rows, cols);
+        const size_t words = grid.words_per_row();
+        if (data.size() != static_cast<size_t>(rows) * words * sizeof(uint64_t)) {
+            throw invalid_file(GridFormat::Raw, path);
+        }
+        const uint64_t mask = last_word_mask(cols);
+        const unsigned char* source = reinterpret_cast<const unsigned char*>(data.data());
+        for (int row = 0; row < rows; row++){
+            uint64_t* target = grid.row(row);
+            for (size_t word = 0; word < words; word++){
+                uint64_t value = 0;
+                for (int byte = 0; byte < 8; byte++){
+                    value |= uint64_t(source[byte]) << (8 * byte);
+                }
+                target[word] = value;
+                source += sizeof(uint64_t);
+            }
+            target[words - 1] &= mask;
+        }
+        return grid;
+    }
+}
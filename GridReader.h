@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include "PackedGrid.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @enum GridFormat
+    *
+    * @brief File formats understood by `GridReader`.
+    */
+    enum class GridFormat{
+        Auto,   // PBM if the file starts with a PBM magic number, text otherwise
+        Pbm,    // plain (P1) or binary (P4) portable bitmap; black pixels are 'true' cells
+        Text,   // one row per line of '0' and '1' characters; blanks and commas are ignored
+        Raw     // PackedGrid layout: rows of little-endian 64-bit words, dimensions given separately
+    };
+
+    /**
+    * @class GridReader
+    *
+    * @brief Loads grid files directly into packed grids.
+    *
+    * Cells are packed as they are parsed, so no `std::vector<std::vector<bool>>` copy of the
+    * grid is ever built. Raw files carry no header; their size must be exactly `rows` times
+    * `(cols + 63) / 64` words of 8 bytes, and bits past the last column are ignored.
+    */
+    class GridReader{
+    public:
+
+        /**
+        * @brief Reads a grid file.
+        *
+        * @param path The path of the file.
+        * @param format The format of the file.
+        * @param rows The number of rows of a raw file; ignored for other formats.
+        * @param cols The number of columns of a raw file; ignored for other formats.
+        * @return The packed grid.
+        * @throws std::runtime_error If the file cannot be read or is not a valid file of the format.
+        * @throws std::invalid_argument If the grid is empty, too large or has rows of different lengths.
+        */
+        static PackedGrid read(const std::string& path, GridFormat format = GridFormat::Auto, int rows = 0, int cols = 0);
+
+        /**
+        * @brief Returns the name of a format: "auto", "pbm", "text" or "raw".
+        */
+        static const char* name(GridFormat format);
+
+    private:
+
+        GridReader() = delete;
+
+        static PackedGrid parse_pbm(const std::string& data, const std::string& path);
+        static PackedGrid parse_text(const std::string& data, const std::string& path);
+        static PackedGrid parse_raw(const std::string& data, const std::string& path, int rows, int cols);
+    };
+}
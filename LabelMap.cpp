@@ -0,0 +1,372 @@
+#include "LabelMap.h"
+#include "ClusterCounter.h"
+#include "ScanKernels.h"
+#include "DisjointSet.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace clusters{
+    namespace{
+
+        // @constant MAGIC Identifies label map files.
+        constexpr char MAGIC[8] = {'C', 'L', 'S', 'T', 'R', 'L', 'E', '1'};
+
+        // @constant VERSION Version of the file layout.
+        constexpr uint32_t VERSION = 1;
+
+        // @constant INITIAL_CAPACITY Size of the first mapping of a new file, in bytes.
+        constexpr size_t INITIAL_CAPACITY = size_t(1) << 20;
+
+        /**
+        * @struct FileHeader
+        *
+        * @brief Header at the start of every label map file; the runs follow it directly.
+        */
+        struct FileHeader{
+            char magic[8];
+            uint32_t version;
+            int32_t rows;
+            int32_t cols;
+            uint32_t clusters;
+            uint64_t run_count;
+            uint64_t index_offset;
+        };
+
+        std::runtime_error io_error(const std::string& what, const std::string& path){
+            return std::runtime_error(what + " label map file: " + path + " (" + std::strerror(errno) + ").");
+        }
+
+        /**
+        * @class MappedOutput
+        *
+        * @brief A file mapped read-write that grows by doubling while it is written.
+        */
+        class MappedOutput{
+        public:
+            explicit MappedOutput(const std::string& path) : path(path){
+                descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (descriptor < 0) {
+                    throw io_error("Cannot create", path);
+                }
+                reserve(INITIAL_CAPACITY);
+            }
+
+            ~MappedOutput(){
+                if (mapping != nullptr) {
+                    ::munmap(mapping, capacity);
+                }
+                if (descriptor >= 0) {
+                    ::close(descriptor);
+                }
+            }
+
+            MappedOutput(const MappedOutput&) = delete;
+            MappedOutput& operator=(const MappedOutput&) = delete;
+
+            // Makes sure the first `size` bytes are mapped. Pointers into the mapping become invalid.
+            void reserve(size_t size){
+                if (size <= capacity) {
+                    return;
+                }
+                size_t grown = std::max(capacity, INITIAL_CAPACITY);
+                while (grown < size) {
+                    grown *= 2;
+                }
+                if (mapping != nullptr) {
+                    ::munmap(mapping, capacity);
+                    mapping = nullptr;
+                }
+                if (::ftruncate(descriptor, static_cast<off_t>(grown)) != 0) {
+                    throw io_error("Cannot resize", path);
+                }
+                void* mapped = ::mmap(nullptr, grown, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+                if (mapped == MAP_FAILED) {
+                    throw io_error("Cannot map", path);
+                }
+                mapping = static_cast<char*>(mapped);
+                capacity = grown;
+            }
+
+            char* data() { return mapping; }
+
+            // Unmaps the file and cuts it to its final size.
+            void finish(size_t size){
+                ::munmap(mapping, capacity);
+                mapping = nullptr;
+                if (::ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+                    throw io_error("Cannot resize", path);
+                }
+            }
+
+        private:
+            std::string path;
+            int descriptor = -1;
+            char* mapping = nullptr;
+            size_t capacity = 0;
+        };
+
+        /**
+        * @brief Labels the rows produced by `extract` and writes the label map.
+        *
+        * Every run takes the provisional label of the first run above it that it overlaps and
+        * unites the labels of the others; runs overlapping nothing get a new provisional label.
+        * Once all rows are written, provisional labels are replaced in place by final labels
+        * numbered in order of first appearance.
+        */
+        template <typename Extract>
+        int write_rows(int rows, int cols, const std::string& path, Extract extract){
+            const size_t words = (static_cast<size_t>(cols) + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+            std::vector<Run> runs(words * PackedGrid::WORD_BITS / 2);
+            std::vector<uint64_t> index(static_cast<size_t>(rows) + 1);
+            DisjointSet sets;
+            MappedOutput output(path);
+            uint64_t total = 0;
+
+            for (int row = 0; row < rows; row++){
+                index[row] = total;
+                const size_t count = extract(row, runs.data());
+                output.reserve(sizeof(FileHeader) + (total + count) * sizeof(LabeledRun));
+
+                LabeledRun* all = reinterpret_cast<LabeledRun*>(output.data() + sizeof(FileHeader));
+                const LabeledRun* previous = row > 0 ? all + index[row - 1] : all;
+                const size_t previous_count = row > 0 ? index[row] - index[row - 1] : 0;
+                LabeledRun* current = all + total;
+
+                size_t above = 0;
+                for (size_t run = 0; run < count; run++){
+                    const Run& cells = runs[run];
+                    while (above < previous_count && previous[above].start + previous[above].length <= static_cast<uint32_t>(cells.start)) {
+                        above++;
+                    }
+                    int label = -1;
+                    for (size_t other = above; other < previous_count && previous[other].start < static_cast<uint32_t>(cells.end); other++){
+                        if (label < 0) {
+                            label = static_cast<int>(previous[other].label);
+                        } else {
+                            sets.unite(label, static_cast<int>(previous[other].label));
+                        }
+                    }
+                    if (label < 0) {
+                        label = sets.make_set();
+                    }
+                    current[run] = {static_cast<uint32_t>(cells.start), static_cast<uint32_t>(cells.end - cells.start),
+                                    static_cast<uint32_t>(label)};
+                }
+                total += count;
+            }
+            index[rows] = total;
+
+            std::vector<uint32_t> final_labels(sets.size(), 0);
+            uint32_t next = 1;
+            LabeledRun* all = reinterpret_cast<LabeledRun*>(output.data() + sizeof(FileHeader));
+            for (uint64_t run = 0; run < total; run++){
+                const int root = sets.find(static_cast<int>(all[run].label));
+                if (final_labels[root] == 0) {
+                    final_labels[root] = next++;
+                }
+                all[run].label = final_labels[root];
+            }
+
+            const uint64_t runs_end = sizeof(FileHeader) + total * sizeof(LabeledRun);
+            const uint64_t index_offset = (runs_end + alignof(uint64_t) - 1) / alignof(uint64_t) * alignof(uint64_t);
+            const size_t file_size = index_offset + index.size() * sizeof(uint64_t);
+            output.reserve(file_size);
+            std::memcpy(output.data() + index_offset, index.data(), index.size() * sizeof(uint64_t));
+
+            FileHeader header;
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.rows = rows;
+            header.cols = cols;
+            header.clusters = next - 1;
+            header.run_count = total;
+            header.index_offset = index_offset;
+            std::memcpy(output.data(), &header, sizeof(header));
+            output.finish(file_size);
+            return static_cast<int>(next - 1);
+        }
+    }
+
+    /**
+    * @brief Labels a packed grid and writes its label map.
+    *
+    * @param grid The grid to be labeled.
+    * @param path The file to be created or overwritten.
+    * @return The number of clusters found.
+    * @throws std::runtime_error If the file cannot be created, resized or mapped.
+    */
+    int LabelMapWriter::write(const PackedGrid& grid, const std::string& path){
+        const ScanKernel& kernel = ScanKernels::active();
+        return write_rows(grid.rows(), grid.cols(), path, [&](int row, Run* runs){
+            return kernel.extract_runs(grid.row(row), grid.words_per_row(), runs);
+        });
+    }
+
+    /**
+    * @brief Labels a grid and writes its label map, packing one row at a time.
+    *
+    * @param grid The grid to be labeled.
+    * @param path The file to be created or overwritten.
+    * @return The number of clusters found.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+    * @throws std::runtime_error If the file cannot be created, resized or mapped.
+    */
+    int LabelMapWriter::write(const std::vector<std::vector<bool>>& grid, const std::string& path){
+        ClusterCounter::validate_input(grid);
+
+        const ScanKernel& kernel = ScanKernels::active();
+        const size_t words = (grid[0].size() + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+        std::vector<uint64_t> packed(words);
+        return write_rows(grid.size(), grid[0].size(), path, [&](int row, Run* runs){
+            PackedGrid::pack_row(grid[row], packed.data());
+            return kernel.extract_runs(packed.data(), words, runs);
+        });
+    }
+
+    /**
+    * @brief Opens and maps a label map file.
+    *
+    * The header and the index are checked against the size of the file, so that a truncated or
+    * foreign file is rejected instead of being read out of bounds.
+    *
+    * @param path The file to be opened.
+    * @throws std::runtime_error If the file cannot be opened or mapped, or is not a valid label map.
+    */
+    LabelMapReader::LabelMapReader(const std::string& path){
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw io_error("Cannot open", path);
+        }
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0) {
+            close();
+            throw io_error("Cannot read", path);
+        }
+        mapping_size = static_cast<size_t>(status.st_size);
+        if (mapping_size < sizeof(FileHeader)) {
+            close();
+            throw std::runtime_error("Not a label map file: " + path + ".");
+        }
+        mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            close();
+            throw io_error("Cannot map", path);
+        }
+
+        const FileHeader* header = static_cast<const FileHeader*>(mapping);
+        const bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 && header->version == VERSION &&
+            header->rows > 0 && header->cols > 0 && header->run_count <= mapping_size / sizeof(LabeledRun) &&
+            header->index_offset >= sizeof(FileHeader) + header->run_count * sizeof(LabeledRun) &&
+            header->index_offset % alignof(uint64_t) == 0 &&
+            header->index_offset <= mapping_size &&
+            (mapping_size - header->index_offset) / sizeof(uint64_t) >= static_cast<uint64_t>(header->rows) + 1;
+        bool ordered = valid;
+        if (valid) {
+            const uint64_t* index = reinterpret_cast<const uint64_t*>(static_cast<const char*>(mapping) + header->index_offset);
+            ordered = index[0] == 0 && index[header->rows] == header->run_count;
+            for (int row = 0; ordered && row < header->rows; row++){
+                ordered = index[row] <= index[row + 1];
+            }
+        }
+        if (!ordered) {
+            close();
+            throw std::runtime_error("Not a label map file: " + path + ".");
+        }
+    }
+
+    LabelMapReader::~LabelMapReader(){
+        close();
+    }
+
+    LabelMapReader::LabelMapReader(LabelMapReader&& other) noexcept
+        : descriptor(std::exchange(other.descriptor, -1)), mapping(std::exchange(other.mapping, nullptr)),
+          mapping_size(std::exchange(other.mapping_size, 0)){
+    }
+
+    LabelMapReader& LabelMapReader::operator=(LabelMapReader&& other) noexcept{
+        if (this != &other) {
+            close();
+            descriptor = std::exchange(other.descriptor, -1);
+            mapping = std::exchange(other.mapping, nullptr);
+            mapping_size = std::exchange(other.mapping_size, 0);
+        }
+        return *this;
+    }
+
+    // @brief Unmaps and closes the file, if open.
+    void LabelMapReader::close(){
+        if (mapping != nullptr) {
+            ::munmap(mapping, mapping_size);
+            mapping = nullptr;
+        }
+        if (descriptor >= 0) {
+            ::close(descriptor);
+            descriptor = -1;
+        }
+    }
+
+    int LabelMapReader::rows() const{
+        return static_cast<const FileHeader*>(mapping)->rows;
+    }
+
+    int LabelMapReader::cols() const{
+        return static_cast<const FileHeader*>(mapping)->cols;
+    }
+
+    int LabelMapReader::clusters() const{
+        return static_cast<int>(static_cast<const FileHeader*>(mapping)->clusters);
+    }
+
+    uint64_t LabelMapReader::runs() const{
+        return static_cast<const FileHeader*>(mapping)->run_count;
+    }
+
+    /**
+    * @brief Returns the labeled runs of a row.
+    *
+    * @param row The row index.
+    * @return The runs of the row, valid while the reader is alive.
+    * @throws std::out_of_range If the row does not exist.
+    */
+    LabelRow LabelMapReader::row(int row) const{
+        if (row < 0 || row >= rows()) {
+            throw std::out_of_range("Row " + std::to_string(row) + " is outside of the label map.");
+        }
+        const char* base = static_cast<const char*>(mapping);
+        const FileHeader* header = reinterpret_cast<const FileHeader*>(base);
+        const uint64_t* index = reinterpret_cast<const uint64_t*>(base + header->index_offset);
+        const LabeledRun* all = reinterpret_cast<const LabeledRun*>(base + sizeof(FileHeader));
+        return {all + index[row], static_cast<size_t>(index[row + 1] - index[row])};
+    }
+
+    /**
+    * @brief Returns the label of a cell.
+    *
+    * @param row The row index.
+    * @param col The column index.
+    * @return The label of the cell's cluster, or 0 if the cell is 'false'.
+    * @throws std::out_of_range If the cell does not exist.
+    */
+    uint32_t LabelMapReader::label(int row, int col) const{
+        if (col < 0 || col >= cols()) {
+            throw std::out_of_range("Column " + std::to_string(col) + " is outside of the label map.");
+        }
+        const LabelRow runs = this->row(row);
+        const LabeledRun* next = std::upper_bound(runs.begin(), runs.end(), static_cast<uint32_t>(col),
+            [](uint32_t value, const LabeledRun& run){ return value < run.start; });
+        if (next == runs.begin()) {
+            return 0;
+        }
+        const LabeledRun& run = *(next - 1);
+        return static_cast<uint32_t>(col) < run.start + run.length ? run.label : 0;
+    }
+}
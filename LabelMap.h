@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "PackedGrid.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @struct LabeledRun
+    *
+    * @brief A run of cells of one row, columns start .. start+length-1, all belonging to cluster `label`.
+    *
+    * Labels are numbered from 1 in the order in which clusters are first met in a row-major scan.
+    */
+    struct LabeledRun{
+        uint32_t start;
+        uint32_t length;
+        uint32_t label;
+    };
+
+    /**
+    * @struct LabelRow
+    *
+    * @brief The labeled runs of one row of a label map, from left to right.
+    */
+    struct LabelRow{
+        const LabeledRun* runs;
+        size_t count;
+
+        const LabeledRun* begin() const { return runs; }
+        const LabeledRun* end() const { return runs + count; }
+    };
+
+    /**
+    * @class LabelMapWriter
+    *
+    * @brief Labels a grid and writes the result as run-length encoded rows to a memory-mapped file.
+    *
+    * The file contains, for every row, the runs of 'true' cells with the label of their cluster.
+    * Its size is proportional to the number of runs, i.e. to the cluster boundaries, instead of
+    * the number of cells. Runs are written into the mapping while the grid is scanned and the
+    * previous row is read back from it, so the only state kept in memory is the table of label
+    * equivalences and one offset per row. A second pass over the mapping replaces provisional
+    * labels by the final ones.
+    *
+    * File layout (native byte order): a fixed header, the runs of all rows in row-major order,
+    * and an index of `rows + 1` run offsets, row `r` owning runs `index[r]` .. `index[r+1]-1`.
+    * Requires a POSIX system with `mmap`.
+    */
+    class LabelMapWriter{
+    public:
+
+        /**
+        * @brief Labels a packed grid and writes its label map.
+        *
+        * @param grid The grid to be labeled.
+        * @param path The file to be created or overwritten.
+        * @return The number of clusters found.
+        * @throws std::runtime_error If the file cannot be created, resized or mapped.
+        */
+        static int write(const PackedGrid& grid, const std::string& path);
+
+        /**
+        * @brief Labels a grid and writes its label map, packing one row at a time.
+        *
+        * @param grid The grid to be labeled.
+        * @param path The file to be created or overwritten.
+        * @return The number of clusters found.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+        * @throws std::runtime_error If the file cannot be created, resized or mapped.
+        */
+        static int write(const std::vector<std::vector<bool>>& grid, const std::string& path);
+
+    private:
+
+        LabelMapWriter() = delete;
+    };
+
+    /**
+    * @class LabelMapReader
+    *
+    * @brief Read-only, memory-mapped access to a label map written by `LabelMapWriter`.
+    *
+    * Rows are located through the index in constant time, and single cells by a binary search
+    * within their row, so only the pages that are actually read are loaded from disk.
+    */
+    class LabelMapReader{
+    public:
+
+        /**
+        * @brief Opens and maps a label map file.
+        *
+        * @param path The file to be opened.
+        * @throws std::runtime_error If the file cannot be opened or mapped, or is not a valid label map.
+        */
+        explicit LabelMapReader(const std::string& path);
+
+        ~LabelMapReader();
+
+        LabelMapReader(LabelMapReader&& other) noexcept;
+        LabelMapReader& operator=(LabelMapReader&& other) noexcept;
+        LabelMapReader(const LabelMapReader&) = delete;
+        LabelMapReader& operator=(const LabelMapReader&) = delete;
+
+        // @brief Returns the number of rows of the labeled grid.
+        int rows() const;
+
+        // @brief Returns the number of columns of the labeled grid.
+        int cols() const;
+
+        // @brief Returns the number of clusters, which is also the largest label.
+        int clusters() const;
+
+        // @brief Returns the total number of runs in the file.
+        uint64_t runs() const;
+
+        /**
+        * @brief Returns the labeled runs of a row.
+        *
+        * @param row The row index.
+        * @return The runs of the row, valid while the reader is alive.
+        * @throws std::out_of_range If the row does not exist.
+        */
+        LabelRow row(int row) const;
+
+        /**
+        * @brief Returns the label of a cell.
+        *
+        * @param row The row index.
+        * @param col The column index.
+        * @return The label of the cell's cluster, or 0 if the cell is 'false'.
+        * @throws std::out_of_range If the cell does not exist.
+        */
+        uint32_t label(int row, int col) const;
+
+    private:
+
+        void close();
+
+        int descriptor = -1;
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+    };
+}
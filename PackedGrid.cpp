@@ -0,0 +1,67 @@
+#include "PackedGrid.h"
+#include "ClusterCounter.h"
+#include <stdexcept>
+#include <algorithm>
+
+
+namespace clusters{
+    /**
+    * @brief Creates a grid with all cells set to 0.
+    *
+    * @param rows The number of rows.
+    * @param cols The number of columns.
+    * @throws std::invalid_argument If a dimension is not positive or the number of cells
+    *         exceeds `ClusterCounter::MAX_CELLS`.
+    */
+    PackedGrid::PackedGrid(int rows, int cols){
+        if (rows <= 0 || cols <= 0) {
+            throw std::invalid_argument("std::vector<std::vector<bool>> cannot be empty or contain empty rows.");
+        }
+        if (rows > ClusterCounter::MAX_CELLS / cols) {
+            throw std::invalid_argument("The number of cells exceeds 2^31 (maximum allowed cells).");
+        }
+        row_count = rows;
+        col_count = cols;
+        stride = (static_cast<size_t>(cols) + WORD_BITS - 1) / WORD_BITS;
+        words.assign(stride * rows, 0);
+    }
+
+    /**
+    * @brief Packs a grid of boolean values.
+    *
+    * @param grid The grid to be packed.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+    */
+    PackedGrid::PackedGrid(const std::vector<std::vector<bool>>& grid){
+        ClusterCounter::validate_input(grid);
+
+        row_count = grid.size();
+        col_count = grid[0].size();
+        stride = (static_cast<size_t>(col_count) + WORD_BITS - 1) / WORD_BITS;
+        words.assign(stride * row_count, 0);
+        for (int current_row = 0; current_row < row_count; current_row++){
+            pack_row(grid[current_row], row(current_row));
+        }
+    }
+
+    /**
+    * @brief Packs one row of boolean values into words, one bit per cell.
+    *
+    * Every word is assembled in a register and stored once, so the target does not need to be
+    * cleared beforehand.
+    *
+    * @param source The row to be packed.
+    * @param target Output array of (source.size() + 63) / 64 words.
+    */
+    void PackedGrid::pack_row(const std::vector<bool>& source, uint64_t* target){
+        const size_t cols = source.size();
+        for (size_t base = 0; base < cols; base += WORD_BITS){
+            const size_t end = std::min(cols, base + WORD_BITS);
+            uint64_t word = 0;
+            for (size_t col = base; col < end; col++){
+                word |= uint64_t(source[col]) << (col - base);
+            }
+            target[base / WORD_BITS] = word;
+        }
+    }
+}
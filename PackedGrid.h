@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+
+namespace clusters{
+
+    /**
+    * @class PackedGrid
+    *
+    * @brief A grid of boolean cells stored as 64-bit words, one bit per cell.
+    *
+    * Every row starts on a word boundary, so the vectorized scan kernels can read a row as a
+    * contiguous array of words. Bit `col % 64` of word `col / 64` holds the cell in column `col`.
+    * Bits past the last column of a row are always 0, which the kernels rely on.
+    */
+    class PackedGrid{
+    public:
+
+        // @constant WORD_BITS The number of cells stored in a single word.
+        static constexpr int WORD_BITS = 64;
+
+        /**
+        * @brief Creates a grid with all cells set to 0.
+        *
+        * @param rows The number of rows.
+        * @param cols The number of columns.
+        * @throws std::invalid_argument If a dimension is not positive or the number of cells
+        *         exceeds `ClusterCounter::MAX_CELLS`.
+        */
+        PackedGrid(int rows, int cols);
+
+        /**
+        * @brief Packs a grid of boolean values.
+        *
+        * @param grid The grid to be packed.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input`.
+        */
+        explicit PackedGrid(const std::vector<std::vector<bool>>& grid);
+
+        // @brief Returns the number of rows.
+        int rows() const { return row_count; }
+
+        // @brief Returns the number of columns.
+        int cols() const { return col_count; }
+
+        // @brief Returns the number of words used by every row.
+        size_t words_per_row() const { return stride; }
+
+        // @brief Returns the words of a row.
+        const uint64_t* row(int row) const { return words.data() + static_cast<size_t>(row) * stride; }
+
+        // @brief Returns the words of a row for modification. Bits past the last column must stay 0.
+        uint64_t* row(int row) { return words.data() + static_cast<size_t>(row) * stride; }
+
+        // @brief Returns the value of a cell.
+        bool get(int row, int col) const {
+            return (this->row(row)[col / WORD_BITS] >> (col % WORD_BITS)) & 1;
+        }
+
+        // @brief Sets the value of a cell.
+        void set(int row, int col, bool value) {
+            const uint64_t mask = uint64_t(1) << (col % WORD_BITS);
+            uint64_t& word = this->row(row)[col / WORD_BITS];
+            word = value ? (word | mask) : (word & ~mask);
+        }
+
+        /**
+        * @brief Packs one row of boolean values into words, one bit per cell.
+        *
+        * @param source The row to be packed.
+        * @param target Output array of (source.size() + 63) / 64 words.
+        */
+        static void pack_row(const std::vector<bool>& source, uint64_t* target);
+
+    private:
+
+        int row_count;
+        int col_count;
+        size_t stride;
+        std::vector<uint64_t> words;
+    };
+}
@@ -0,0 +1,63 @@
+#include "RowMerger.h"
+
+
+namespace clusters{
+    /**
+    * @brief Adds the next row, given its runs from left to right.
+    *
+    * The labels of the previous row are elements 0 .. previous_label_count-1 of the disjoint
+    * set and the runs of the new row are appended after them. Overlapping runs are found with a
+    * single merge-like walk over both rows. Finally the labels of the new row are renumbered
+    * compactly so that the state never grows beyond one row.
+    *
+    * @param runs The runs of the row.
+    * @param count The number of runs.
+    */
+    void RowMerger::push(const Run* runs, size_t count){
+        sets.reset(previous_label_count);
+        labels.resize(count);
+        for (size_t run = 0; run < count; run++){
+            labels[run] = sets.make_set();
+        }
+        cluster_count += static_cast<int>(count);
+
+        size_t above = 0;
+        size_t current = 0;
+        while (above < previous_runs.size() && current < count) {
+            const Run& upper = previous_runs[above];
+            const Run& lower = runs[current];
+            if (upper.start < lower.end && lower.start < upper.end &&
+                sets.unite(previous_labels[above], labels[current])) {
+                cluster_count--;
+            }
+            if (upper.end < lower.end) {
+                above++;
+            } else {
+                current++;
+            }
+        }
+
+        compact.assign(sets.size(), -1);
+        int label_count = 0;
+        for (size_t run = 0; run < count; run++){
+            const int root = sets.find(labels[run]);
+            if (compact[root] < 0) {
+                compact[root] = label_count++;
+            }
+            labels[run] = compact[root];
+        }
+        previous_runs.assign(runs, runs + count);
+        previous_labels.swap(labels);
+        previous_label_count = label_count;
+    }
+
+    /**
+    * @brief Forgets all rows added so far.
+    */
+    void RowMerger::reset(){
+        previous_runs.clear();
+        previous_labels.clear();
+        previous_label_count = 0;
+        cluster_count = 0;
+    }
+}
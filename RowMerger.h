@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include "ScanKernels.h"
+#include "DisjointSet.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @class RowMerger
+    *
+    * @brief Counts clusters from the runs of consecutive rows, keeping only one row of state.
+    *
+    * Every run starts as a new cluster. A run of the current row that overlaps a run of the
+    * previous row joins its cluster, and a run that overlaps two clusters of the previous row
+    * merges them. Only the clusters touching the previous row are tracked, so the memory used
+    * depends on the width of the grid and not on its height.
+    */
+    class RowMerger{
+    public:
+
+        /**
+        * @brief Adds the next row, given its runs from left to right.
+        *
+        * @param runs The runs of the row.
+        * @param count The number of runs.
+        */
+        void push(const Run* runs, size_t count);
+
+        /**
+        * @brief Returns the number of clusters in the rows added so far.
+        */
+        int clusters() const { return cluster_count; }
+
+        /**
+        * @brief Forgets all rows added so far.
+        */
+        void reset();
+
+    private:
+
+        std::vector<Run> previous_runs;
+        std::vector<int> previous_labels;
+        int previous_label_count = 0;
+        std::vector<int> labels;
+        std::vector<int> compact;
+        DisjointSet sets;
+        int cluster_count = 0;
+    };
+}
@@ -0,0 +1,501 @@
+#include "ScanKernels.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CLUSTERS_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define CLUSTERS_X86_KERNELS 0
+#endif
+
+
+namespace clusters{
+    namespace{
+
+        // @constant PACK_BOUNDARIES Number of boundaries in a word above which the vector kernels pack them in blocks.
+        constexpr int PACK_BOUNDARIES = 4;
+
+        // Positions of the set bits of every byte, from the lowest one; the remaining entries are 0.
+        constexpr std::array<std::array<uint8_t, 8>, 256> make_bit_positions(){
+            std::array<std::array<uint8_t, 8>, 256> table{};
+            for (int byte = 0; byte < 256; byte++){
+                int found = 0;
+                for (int bit = 0; bit < 8; bit++){
+                    if (byte >> bit & 1) {
+                        table[byte][found++] = static_cast<uint8_t>(bit);
+                    }
+                }
+            }
+            return table;
+        }
+
+        constexpr std::array<std::array<uint8_t, 8>, 256> BIT_POSITIONS = make_bit_positions();
+
+        static_assert(sizeof(Run) == 2 * sizeof(int) && offsetof(Run, end) == sizeof(int),
+                      "The runs of a row are written as a flat array of boundaries.");
+
+        /**
+        * @brief Returns the runs as a flat array of boundaries: the start and end of the first run,
+        * then of the second one, and so on.
+        *
+        * Along a row, starts and ends alternate and the first boundary is a start, so writing the
+        * columns where a cell differs from the previous one in order fills the runs.
+        */
+        inline int* boundaries_of(Run* runs){
+            return &runs->start;
+        }
+
+        // Writes the column of every bit of `boundaries`, from the lowest one.
+        inline void emit_boundaries(uint64_t boundaries, int base, int* bounds, size_t& count){
+            while (boundaries) {
+                bounds[count++] = base + __builtin_ctzll(boundaries);
+                boundaries &= boundaries - 1;
+            }
+        }
+
+        /**
+        * @brief Emits the run boundaries found in one word.
+        *
+        * A boundary is a cell that differs from the previous one: a run starts where a bit is
+        * set and the previous bit is not, and ends where a bit is clear and the previous bit is
+        * set. `carry` holds the last bit of the previous word. Words without a boundary (all 0
+        * outside a run, all 1 inside one) emit nothing.
+        */
+        inline void scan_word(uint64_t word, int base, uint64_t& carry, int* bounds, size_t& count){
+            const uint64_t boundaries = word ^ ((word << 1) | carry);
+            carry = word >> 63;
+            emit_boundaries(boundaries, base, bounds, count);
+        }
+
+        // Closes a run that reaches the end of the last word and returns the number of runs.
+        inline size_t finish_row(size_t word_count, uint64_t carry, int* bounds, size_t count){
+            if (carry) {
+                bounds[count++] = static_cast<int>(word_count * 64);
+            }
+            return count / 2;
+        }
+
+        /**
+        * @brief Portable kernel: scans one word at a time.
+        */
+        size_t extract_runs_scalar(const uint64_t* words, size_t word_count, Run* runs){
+            int* bounds = boundaries_of(runs);
+            size_t count = 0;
+            uint64_t carry = 0;
+            for (size_t index = 0; index < word_count; index++){
+                scan_word(words[index], static_cast<int>(index * 64), carry, bounds, count);
+            }
+            return finish_row(word_count, carry, bounds, count);
+        }
+
+        /**
+        * @brief Adds the bit-quads of 64 columns, given the four cells of every pattern as masks.
+        *
+        * The cells are added with bit-sliced half adders: `odd` marks the patterns with an odd
+        * number of 'true' cells, and the pair masks tell one from three and two from four.
+        * `a` and `b` are the upper-left and upper-right cells, `c` and `d` the lower ones.
+        */
+        inline void add_quads(uint64_t a, uint64_t b, uint64_t c, uint64_t d, QuadCounts& counts){
+            const uint64_t top = a ^ b;
+            const uint64_t bottom = c ^ d;
+            const uint64_t top_pair = a & b;
+            const uint64_t bottom_pair = c & d;
+            const uint64_t pairs = top_pair | bottom_pair;
+            const uint64_t odd = top ^ bottom;
+            const uint64_t cross = top & bottom;                // one cell in each row
+            const uint64_t diagonals = cross & ~(a ^ d);
+            const uint64_t twos = ((top_pair ^ bottom_pair) & ~odd) | (cross & ~diagonals);
+            counts.one += __builtin_popcountll(odd & ~pairs);
+            counts.three += __builtin_popcountll(odd & pairs);
+            counts.two += __builtin_popcountll(twos);
+            counts.diagonal += __builtin_popcountll(diagonals);
+        }
+
+        /**
+        * @brief Adds the bit-quads of words first .. last-1 of two rows; the left cells come from the previous word.
+        *
+        * Patterns without a 'true' cell are not counted, so words that are 0 in both rows, with
+        * no cell carried in from the left, are skipped.
+        */
+        inline void add_quad_words(const uint64_t* upper, const uint64_t* lower, size_t first, size_t last, QuadCounts& counts){
+            uint64_t upper_carry = first > 0 ? upper[first - 1] >> 63 : 0;
+            uint64_t lower_carry = first > 0 ? lower[first - 1] >> 63 : 0;
+            for (size_t index = first; index < last; index++){
+                const uint64_t upper_word = upper[index];
+                const uint64_t lower_word = lower[index];
+                if ((upper_word | lower_word | upper_carry | lower_carry) != 0) {
+                    add_quads((upper_word << 1) | upper_carry, upper_word, (lower_word << 1) | lower_carry, lower_word, counts);
+                }
+                upper_carry = upper_word >> 63;
+                lower_carry = lower_word >> 63;
+            }
+        }
+
+        // Adds the bit-quad hanging past the last word, whose right cells are 0.
+        inline void add_last_quad(const uint64_t* upper, const uint64_t* lower, size_t word_count, QuadCounts& counts){
+            const uint64_t cells = (upper[word_count - 1] >> 63) + (lower[word_count - 1] >> 63);
+            counts.one += cells == 1;
+            counts.two += cells == 2;
+        }
+
+        /**
+        * @brief Portable bit-quad kernel: one word of patterns at a time.
+        */
+        void count_quads_scalar(const uint64_t* upper, const uint64_t* lower, size_t word_count, QuadCounts& counts){
+            add_quad_words(upper, lower, 0, word_count, counts);
+            add_last_quad(upper, lower, word_count, counts);
+        }
+
+#if CLUSTERS_X86_KERNELS
+        /**
+        * @brief Writes the boundaries of one word in blocks of 8 bits, through `BIT_POSITIONS`.
+        *
+        * Every byte writes the positions of its 8 bits, of which only the first ones are kept:
+        * the next byte writes over the rest. A row has at most as many boundaries before a
+        * column as there are columns before it, so the writes of a byte never pass the
+        * capacity of 64 * word_count boundaries.
+        */
+        __attribute__((target("sse4.2,popcnt")))
+        inline void pack_boundaries_sse42(uint64_t boundaries, int base, int* bounds, size_t& count){
+            for (int chunk = 0; chunk < 8; chunk++){
+                const unsigned byte = (boundaries >> (8 * chunk)) & 0xFF;
+                const __m128i positions = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(BIT_POSITIONS[byte].data()));
+                const __m128i columns = _mm_set1_epi32(base + 8 * chunk);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds + count), _mm_add_epi32(_mm_cvtepu8_epi32(positions), columns));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(bounds + count + 4),
+                                 _mm_add_epi32(_mm_cvtepu8_epi32(_mm_srli_si128(positions, 4)), columns));
+                count += __builtin_popcount(byte);
+            }
+        }
+
+        // The AVX2 form of `pack_boundaries_sse42`: the 8 positions of a byte in one store.
+        __attribute__((target("avx2,popcnt")))
+        inline void pack_boundaries_avx2(uint64_t boundaries, int base, int* bounds, size_t& count){
+            for (int chunk = 0; chunk < 8; chunk++){
+                const unsigned byte = (boundaries >> (8 * chunk)) & 0xFF;
+                const __m128i positions = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(BIT_POSITIONS[byte].data()));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(bounds + count),
+                                    _mm256_add_epi32(_mm256_cvtepu8_epi32(positions), _mm256_set1_epi32(base + 8 * chunk)));
+                count += __builtin_popcount(byte);
+            }
+        }
+
+        /**
+        * @brief SSE4.2 kernel: the boundaries of 2 words at a time.
+        *
+        * The previous cell of every bit is the bit below it, shifted in from the last bit of the
+        * previous word, which is loaded from the same row one word earlier; the first word is
+        * therefore handled by the portable code. Blocks without a boundary are skipped.
+        */
+        __attribute__((target("sse4.2,popcnt")))
+        size_t extract_runs_sse42(const uint64_t* words, size_t word_count, Run* runs){
+            int* bounds = boundaries_of(runs);
+            size_t count = 0;
+            uint64_t carry = 0;
+            scan_word(words[0], 0, carry, bounds, count);
+            alignas(16) uint64_t boundaries[2];
+            size_t index = 1;
+            for (; index + 2 <= word_count; index += 2){
+                const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + index));
+                const __m128i before = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + index - 1));
+                const __m128i changes = _mm_xor_si128(block, _mm_or_si128(_mm_slli_epi64(block, 1), _mm_srli_epi64(before, 63)));
+                if (_mm_testz_si128(changes, changes)) {
+                    continue;
+                }
+                _mm_store_si128(reinterpret_cast<__m128i*>(boundaries), changes);
+                for (int lane = 0; lane < 2; lane++){
+                    const int base = static_cast<int>((index + lane) * 64);
+                    if (__builtin_popcountll(boundaries[lane]) > PACK_BOUNDARIES) {
+                        pack_boundaries_sse42(boundaries[lane], base, bounds, count);
+                    } else {
+                        emit_boundaries(boundaries[lane], base, bounds, count);
+                    }
+                }
+            }
+            carry = words[index - 1] >> 63;
+            for (; index < word_count; index++){
+                scan_word(words[index], static_cast<int>(index * 64), carry, bounds, count);
+            }
+            return finish_row(word_count, carry, bounds, count);
+        }
+
+        /**
+        * @brief AVX2 kernel: the boundaries of 4 words at a time, as in the SSE4.2 kernel.
+        */
+        __attribute__((target("avx2,popcnt")))
+        size_t extract_runs_avx2(const uint64_t* words, size_t word_count, Run* runs){
+            int* bounds = boundaries_of(runs);
+            size_t count = 0;
+            uint64_t carry = 0;
+            scan_word(words[0], 0, carry, bounds, count);
+            alignas(32) uint64_t boundaries[4];
+            size_t index = 1;
+            for (; index + 4 <= word_count; index += 4){
+                const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + index));
+                const __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + index - 1));
+                const __m256i changes = _mm256_xor_si256(block, _mm256_or_si256(_mm256_slli_epi64(block, 1), _mm256_srli_epi64(before, 63)));
+                if (_mm256_testz_si256(changes, changes)) {
+                    continue;
+                }
+                _mm256_store_si256(reinterpret_cast<__m256i*>(boundaries), changes);
+                const __m256i empty = _mm256_cmpeq_epi64(changes, _mm256_setzero_si256());
+                for (unsigned lanes = ~_mm256_movemask_pd(_mm256_castsi256_pd(empty)) & 0xF; lanes; lanes &= lanes - 1){
+                    const int lane = __builtin_ctz(lanes);
+                    const int base = static_cast<int>((index + lane) * 64);
+                    if (__builtin_popcountll(boundaries[lane]) > PACK_BOUNDARIES) {
+                        pack_boundaries_avx2(boundaries[lane], base, bounds, count);
+                    } else {
+                        emit_boundaries(boundaries[lane], base, bounds, count);
+                    }
+                }
+            }
+            carry = words[index - 1] >> 63;
+            for (; index < word_count; index++){
+                scan_word(words[index], static_cast<int>(index * 64), carry, bounds, count);
+            }
+            return finish_row(word_count, carry, bounds, count);
+        }
+
+        /**
+        * @brief Writes the boundaries of one word with four compressions of 16 columns each.
+        *
+        * The columns of the set bits are packed to the front of a vector of 16 columns and
+        * stored with a mask, so nothing is written past the last boundary.
+        */
+        __attribute__((target("avx512f,popcnt")))
+        inline void compress_boundaries(uint64_t boundaries, int base, int* bounds, size_t& count){
+            const __m512i sixteen = _mm512_set1_epi32(16);
+            __m512i columns = _mm512_add_epi32(_mm512_set1_epi32(base),
+                                               _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+            for (int chunk = 0; chunk < 4; chunk++){
+                const __mmask16 mask = static_cast<__mmask16>(boundaries >> (16 * chunk));
+                const int found = __builtin_popcount(mask);
+                _mm512_mask_storeu_epi32(bounds + count, static_cast<__mmask16>((1u << found) - 1),
+                                         _mm512_maskz_compress_epi32(mask, columns));
+                count += found;
+                columns = _mm512_add_epi32(columns, sixteen);
+            }
+        }
+
+        /**
+        * @brief AVX-512 kernel: the boundaries of 8 words at a time, as in the SSE4.2 kernel.
+        *
+        * The words holding a boundary come out of a mask register. Words with many boundaries
+        * are written by compression instead of one bit at a time.
+        */
+        __attribute__((target("avx512f,popcnt")))
+        size_t extract_runs_avx512(const uint64_t* words, size_t word_count, Run* runs){
+            int* bounds = boundaries_of(runs);
+            size_t count = 0;
+            uint64_t carry = 0;
+            scan_word(words[0], 0, carry, bounds, count);
+            alignas(64) uint64_t boundaries[8];
+            size_t index = 1;
+            for (; index + 8 <= word_count; index += 8){
+                const __m512i block = _mm512_loadu_si512(words + index);
+                const __m512i before = _mm512_loadu_si512(words + index - 1);
+                const __m512i previous = _mm512_or_epi64(_mm512_maskz_slli_epi64(0xFF, block, 1), _mm512_maskz_srli_epi64(0xFF, before, 63));
+                const __m512i changes = _mm512_xor_epi64(block, previous);
+                unsigned lanes = _mm512_test_epi64_mask(changes, changes);
+                if (lanes == 0) {
+                    continue;
+                }
+                _mm512_store_si512(boundaries, changes);
+                for (; lanes; lanes &= lanes - 1){
+                    const int lane = __builtin_ctz(lanes);
+                    const int base = static_cast<int>((index + lane) * 64);
+                    if (__builtin_popcountll(boundaries[lane]) > PACK_BOUNDARIES) {
+                        compress_boundaries(boundaries[lane], base, bounds, count);
+                    } else {
+                        emit_boundaries(boundaries[lane], base, bounds, count);
+                    }
+                }
+            }
+            carry = words[index - 1] >> 63;
+            for (; index < word_count; index++){
+                scan_word(words[index], static_cast<int>(index * 64), carry, bounds, count);
+            }
+            return finish_row(word_count, carry, bounds, count);
+        }
+
+        /**
+        * @brief SSE4.2 bit-quad kernel: the portable kernel with the hardware population count.
+        */
+        __attribute__((target("sse4.2,popcnt")))
+        void count_quads_sse42(const uint64_t* upper, const uint64_t* lower, size_t word_count, QuadCounts& counts){
+            add_quad_words(upper, lower, 0, word_count, counts);
+            add_last_quad(upper, lower, word_count, counts);
+        }
+
+        // Population count of every 64-bit lane, through a nibble lookup table and a sum of bytes.
+        __attribute__((target("avx2")))
+        inline __m256i popcount_lanes(__m256i value){
+            const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i nibbles = _mm256_set1_epi8(0x0F);
+            const __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(value, nibbles));
+            const __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(value, 4), nibbles));
+            return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+        }
+
+        __attribute__((target("avx2")))
+        inline uint64_t sum_lanes(__m256i value){
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), value);
+            return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+
+        /**
+        * @brief AVX2 bit-quad kernel: the patterns of 4 words at a time.
+        *
+        * The left cells of every word are loaded from the same rows one word earlier, so the
+        * first word is handled by the portable code. Blocks without a 'true' cell are skipped.
+        */
+        __attribute__((target("avx2,popcnt")))
+        void count_quads_avx2(const uint64_t* upper, const uint64_t* lower, size_t word_count, QuadCounts& counts){
+            add_quad_words(upper, lower, 0, 1, counts);
+            __m256i one = _mm256_setzero_si256(), two = one, three = one, diagonal = one;
+            size_t index = 1;
+            for (; index + 4 <= word_count; index += 4){
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(upper + index));
+                const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lower + index));
+                const __m256i upper_previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(upper + index - 1));
+                const __m256i lower_previous = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lower + index - 1));
+                const __m256i a = _mm256_or_si256(_mm256_slli_epi64(b, 1), _mm256_srli_epi64(upper_previous, 63));
+                const __m256i c = _mm256_or_si256(_mm256_slli_epi64(d, 1), _mm256_srli_epi64(lower_previous, 63));
+                const __m256i cells = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+                if (_mm256_testz_si256(cells, cells)) {
+                    continue;
+                }
+
+                const __m256i top = _mm256_xor_si256(a, b);
+                const __m256i bottom = _mm256_xor_si256(c, d);
+                const __m256i top_pair = _mm256_and_si256(a, b);
+                const __m256i bottom_pair = _mm256_and_si256(c, d);
+                const __m256i pairs = _mm256_or_si256(top_pair, bottom_pair);
+                const __m256i odd = _mm256_xor_si256(top, bottom);
+                const __m256i cross = _mm256_and_si256(top, bottom);
+                const __m256i diagonals = _mm256_andnot_si256(_mm256_xor_si256(a, d), cross);
+                const __m256i twos = _mm256_or_si256(_mm256_andnot_si256(odd, _mm256_xor_si256(top_pair, bottom_pair)),
+                                                     _mm256_andnot_si256(diagonals, cross));
+                one = _mm256_add_epi64(one, popcount_lanes(_mm256_andnot_si256(pairs, odd)));
+                three = _mm256_add_epi64(three, popcount_lanes(_mm256_and_si256(pairs, odd)));
+                two = _mm256_add_epi64(two, popcount_lanes(twos));
+                diagonal = _mm256_add_epi64(diagonal, popcount_lanes(diagonals));
+            }
+            counts.one += sum_lanes(one);
+            counts.two += sum_lanes(two);
+            counts.three += sum_lanes(three);
+            counts.diagonal += sum_lanes(diagonal);
+            add_quad_words(upper, lower, index, word_count, counts);
+            add_last_quad(upper, lower, word_count, counts);
+        }
+#endif
+
+        const ScanKernel kernels[] = {
+            {KernelIsa::Scalar, "scalar", extract_runs_scalar, count_quads_scalar},
+#if CLUSTERS_X86_KERNELS
+            {KernelIsa::SSE42, "sse4.2", extract_runs_sse42, count_quads_sse42},
+            {KernelIsa::AVX2, "avx2", extract_runs_avx2, count_quads_avx2},
+            {KernelIsa::AVX512, "avx512", extract_runs_avx512, count_quads_avx2},
+#else
+            {KernelIsa::SSE42, "sse4.2", extract_runs_scalar, count_quads_scalar},
+            {KernelIsa::AVX2, "avx2", extract_runs_scalar, count_quads_scalar},
+            {KernelIsa::AVX512, "avx512", extract_runs_scalar, count_quads_scalar},
+#endif
+        };
+
+        std::atomic<const ScanKernel*> selected{nullptr};
+    }
+
+    /**
+    * @brief Returns the kernel used by the counting engines.
+    *
+    * The kernel is selected once, on the first call, unless `force` has been called before.
+    *
+    * @return The active kernel.
+    */
+    const ScanKernel& ScanKernels::active(){
+        const ScanKernel* kernel = selected.load(std::memory_order_acquire);
+        if (kernel == nullptr) {
+            const ScanKernel* detected = &get(detect());
+            selected.compare_exchange_strong(kernel, detected, std::memory_order_acq_rel);
+            kernel = selected.load(std::memory_order_acquire);
+        }
+        return *kernel;
+    }
+
+    /**
+    * @brief Returns the best instruction set supported by both the build and the CPU.
+    */
+    KernelIsa ScanKernels::detect(){
+        for (KernelIsa isa : {KernelIsa::AVX512, KernelIsa::AVX2, KernelIsa::SSE42}) {
+            if (supported(isa)) {
+                return isa;
+            }
+        }
+        return KernelIsa::Scalar;
+    }
+
+    /**
+    * @brief Checks whether a kernel variant can run on this CPU.
+    *
+    * @param isa The instruction set of the kernel.
+    * @return True if the kernel has been compiled in and the CPU supports it.
+    */
+    bool ScanKernels::supported(KernelIsa isa){
+        if (isa == KernelIsa::Scalar) {
+            return true;
+        }
+#if CLUSTERS_X86_KERNELS
+        __builtin_cpu_init();
+        switch (isa) {
+            case KernelIsa::SSE42:
+                return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+            case KernelIsa::AVX2:
+                return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+            case KernelIsa::AVX512:
+                return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") &&
+                       __builtin_cpu_supports("popcnt");
+            default:
+                return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    /**
+    * @brief Makes the engines use a specific kernel instead of the detected one.
+    *
+    * @param isa The instruction set of the kernel.
+    * @throws std::invalid_argument If the kernel is not supported on this CPU.
+    */
+    void ScanKernels::force(KernelIsa isa){
+        if (!supported(isa)) {
+            throw std::invalid_argument(std::string("Kernel ") + get(isa).name + " is not supported on this CPU.");
+        }
+        selected.store(&get(isa), std::memory_order_release);
+    }
+
+    /**
+    * @brief Returns to the kernel chosen by `detect`.
+    */
+    void ScanKernels::reset(){
+        selected.store(&get(detect()), std::memory_order_release);
+    }
+
+    /**
+    * @brief Returns the kernel compiled for an instruction set, whether or not the CPU supports it.
+    *
+    * @param isa The instruction set of the kernel.
+    * @return The kernel table.
+    */
+    const ScanKernel& ScanKernels::get(KernelIsa isa){
+        return kernels[static_cast<int>(isa)];
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+
+
+namespace clusters{
+
+    /**
+    * @struct Run
+    *
+    * @brief A maximal horizontal run of 'true' cells in one row, covering columns start .. end-1.
+    */
+    struct Run{
+        int start;
+        int end;
+    };
+
+    /**
+    * @struct QuadCounts
+    *
+    * @brief Numbers of 2x2 cell patterns (bit-quads) by the 'true' cells they contain.
+    *
+    * Patterns with 0 or 4 'true' cells are not counted; `two` excludes the two diagonal
+    * patterns, which are counted in `diagonal`.
+    */
+    struct QuadCounts{
+        uint64_t one = 0;
+        uint64_t two = 0;
+        uint64_t three = 0;
+        uint64_t diagonal = 0;
+    };
+
+    /**
+    * @enum KernelIsa
+    *
+    * @brief Instruction set a scan kernel is compiled for, from the most to the least portable.
+    */
+    enum class KernelIsa{
+        Scalar,
+        SSE42,
+        AVX2,
+        AVX512
+    };
+
+    /**
+    * @struct ScanKernel
+    *
+    * @brief Table of the row-scan hot loops compiled for one instruction set.
+    */
+    struct ScanKernel{
+        KernelIsa isa;
+        const char* name;
+
+        /**
+        * @brief Extracts the runs of a packed row.
+        *
+        * Bits past the last column must be 0. `runs` must have room for (64 * word_count + 1) / 2
+        * entries, the largest number of runs a row of that many words can hold.
+        *
+        * @param words The words of the row.
+        * @param word_count The number of words in the row.
+        * @param runs Output array receiving the runs from left to right.
+        * @return The number of runs written.
+        */
+        size_t (*extract_runs)(const uint64_t* words, size_t word_count, Run* runs);
+
+        /**
+        * @brief Adds the bit-quads formed by two consecutive packed rows to `counts`.
+        *
+        * Counts the 64 * word_count + 1 patterns whose lower-right cell is in column 0 to
+        * 64 * word_count of `lower`, with column -1 taken as 0. Bits past the last column must be 0.
+        *
+        * @param upper The words of the upper row.
+        * @param lower The words of the lower row.
+        * @param word_count The number of words in each row.
+        * @param counts The counts to be increased.
+        */
+        void (*count_quads)(const uint64_t* upper, const uint64_t* lower, size_t word_count, QuadCounts& counts);
+    };
+
+    /**
+    * @class ScanKernels
+    *
+    * @brief Selects the row-scan kernel for the CPU the program is running on.
+    *
+    * The library is compiled for a generic target, and every kernel variant is compiled for its
+    * own instruction set through function target attributes. On first use the best variant the
+    * CPU supports is picked from CPUID, so one binary uses the full vector width of every host it
+    * is deployed on. `force` overrides the choice for testing and benchmarking.
+    */
+    class ScanKernels{
+    public:
+
+        /**
+        * @brief Returns the kernel used by the counting engines.
+        *
+        * The kernel is selected once, on the first call, unless `force` has been called before.
+        *
+        * @return The active kernel.
+        */
+        static const ScanKernel& active();
+
+        /**
+        * @brief Returns the best instruction set supported by both the build and the CPU.
+        */
+        static KernelIsa detect();
+
+        /**
+        * @brief Checks whether a kernel variant can run on this CPU.
+        *
+        * @param isa The instruction set of the kernel.
+        * @return True if the kernel has been compiled in and the CPU supports it.
+        */
+        static bool supported(KernelIsa isa);
+
+        /**
+        * @brief Makes the engines use a specific kernel instead of the detected one.
+        *
+        * @param isa The instruction set of the kernel.
+        * @throws std::invalid_argument If the kernel is not supported on this CPU.
+        */
+        static void force(KernelIsa isa);
+
+        /**
+        * @brief Returns to the kernel chosen by `detect`.
+        */
+        static void reset();
+
+        /**
+        * @brief Returns the kernel compiled for an instruction set, whether or not the CPU supports it.
+        *
+        * @param isa The instruction set of the kernel.
+        * @return The kernel table.
+        */
+        static const ScanKernel& get(KernelIsa isa);
+
+    private:
+
+        ScanKernels() = delete;
+    };
+}
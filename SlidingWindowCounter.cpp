@@ -0,0 +1,74 @@
+#include "SlidingWindowCounter.h"
+#include "PackedGrid.h"
+#include <stdexcept>
+
+
+namespace clusters{
+    /**
+    * @brief Creates an empty window for rows of a fixed width.
+    *
+    * @param cols The number of cells in every row.
+    * @throws std::invalid_argument If `cols` is not positive.
+    */
+    SlidingWindowCounter::SlidingWindowCounter(int cols) : col_count(cols){
+        if (cols <= 0) {
+            throw std::invalid_argument("std::vector<std::vector<bool>> cannot be empty or contain empty rows.");
+        }
+        const size_t words = (static_cast<size_t>(cols) + PackedGrid::WORD_BITS - 1) / PackedGrid::WORD_BITS;
+        packed.resize(words);
+        runs.resize(words * PackedGrid::WORD_BITS / 2);
+    }
+
+    /**
+    * @brief Adds a row at the bottom of the window.
+    *
+    * The row is reduced to its runs by the active scan kernel and appended to the summary of
+    * the newer rows. Its runs are kept until the row moves to the older part.
+    *
+    * @param row The cells of the row.
+    * @throws std::invalid_argument If the row does not have `cols()` cells.
+    */
+    void SlidingWindowCounter::push_row(const std::vector<bool>& row){
+        if (row.size() != static_cast<size_t>(col_count)) {
+            throw std::invalid_argument("All rows in the grid must have the same number of cells.");
+        }
+        PackedGrid::pack_row(row, packed.data());
+        const size_t count = ScanKernels::active().extract_runs(packed.data(), packed.size(), runs.data());
+        newer.append(runs.data(), count);
+        newer_rows.emplace_back(runs.begin(), runs.begin() + count);
+    }
+
+    /**
+    * @brief Removes the row at the top of the window.
+    *
+    * When the older part is empty, the newer rows are moved to it, building the summary of
+    * every suffix from the bottom row upwards.
+    *
+    * @throws std::out_of_range If the window is empty.
+    */
+    void SlidingWindowCounter::pop_row(){
+        if (rows() == 0) {
+            throw std::out_of_range("Cannot pop a row from an empty window.");
+        }
+        if (older.empty()) {
+            older.reserve(newer_rows.size());
+            for (auto row = newer_rows.rbegin(); row != newer_rows.rend(); ++row){
+                const BandSummary single(row->data(), row->size());
+                older.push_back(older.empty() ? single : BandSummary::merge(single, older.back()));
+            }
+            newer_rows.clear();
+            newer = BandSummary();
+        }
+        older.pop_back();
+    }
+
+    /**
+    * @brief Returns the number of clusters in the window.
+    */
+    int SlidingWindowCounter::count_clusters() const{
+        if (older.empty()) {
+            return newer.clusters();
+        }
+        return BandSummary::merge(older.back(), newer).clusters();
+    }
+}
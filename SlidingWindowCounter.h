@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "BandSummary.h"
+#include "ScanKernels.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @class SlidingWindowCounter
+    *
+    * @brief Keeps the cluster count of a window of rows that enter at the bottom and leave at the top.
+    *
+    * Removing a row can split a cluster, which a plain union-find cannot undo. The window is
+    * therefore kept as a queue made of two stacks of `BandSummary` values: new rows are appended
+    * to the summary of the newer part, and the older part stores, for every row, the summary of
+    * that row and all rows below it up to the end of the older part. Popping a row drops one of
+    * these summaries, and when the older part runs out the newer part is turned into summaries
+    * once. Every row is summarized a constant number of times, and each summary operation only
+    * looks at the runs of boundary rows, so the amortized cost of `push_row`, `pop_row` and
+    * `count_clusters` depends on the width of the rows and not on the height of the window.
+    */
+    class SlidingWindowCounter{
+    public:
+
+        /**
+        * @brief Creates an empty window for rows of a fixed width.
+        *
+        * @param cols The number of cells in every row.
+        * @throws std::invalid_argument If `cols` is not positive.
+        */
+        explicit SlidingWindowCounter(int cols);
+
+        /**
+        * @brief Adds a row at the bottom of the window.
+        *
+        * @param row The cells of the row.
+        * @throws std::invalid_argument If the row does not have `cols()` cells.
+        */
+        void push_row(const std::vector<bool>& row);
+
+        /**
+        * @brief Removes the row at the top of the window.
+        *
+        * @throws std::out_of_range If the window is empty.
+        */
+        void pop_row();
+
+        /**
+        * @brief Returns the number of clusters in the window.
+        */
+        int count_clusters() const;
+
+        // @brief Returns the number of rows in the window.
+        int rows() const { return static_cast<int>(older.size() + newer_rows.size()); }
+
+        // @brief Returns the number of cells in every row.
+        int cols() const { return col_count; }
+
+    private:
+
+        int col_count;
+        std::vector<BandSummary> older;             // older.back() summarizes all older rows
+        std::vector<std::vector<Run>> newer_rows;   // runs of the newer rows, top to bottom
+        BandSummary newer;                          // summary of all newer rows
+        std::vector<uint64_t> packed;
+        std::vector<Run> runs;
+    };
+}
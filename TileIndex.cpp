@@ -0,0 +1,233 @@
+#include "TileIndex.h"
+#include "DisjointSet.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace clusters{
+    /**
+    * @brief Builds the index for a grid.
+    *
+    * Every tile is labeled once, so building costs about as much as a single full count.
+    *
+    * @param grid The grid to be indexed. It must outlive the index and stay unchanged.
+    * @param tile_size The side length of a tile, in cells.
+    * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input` or
+    *         `tile_size` is not positive.
+    */
+    TileIndex::TileIndex(const std::vector<std::vector<bool>>& grid, int tile_size) : grid(grid){
+        ClusterCounter::validate_input(grid);
+        if (tile_size <= 0) {
+            throw std::invalid_argument("Tile size must be positive.");
+        }
+
+        grid_rows = grid.size();
+        grid_cols = grid[0].size();
+        tile_side = tile_size;
+        tile_rows = (grid_rows + tile_side - 1) / tile_side;
+        tile_cols = (grid_cols + tile_side - 1) / tile_side;
+
+        std::vector<int> labels;
+        tiles.reserve(static_cast<size_t>(tile_rows) * tile_cols);
+        for (int tile_row = 0; tile_row < tile_rows; tile_row++){
+            for (int tile_col = 0; tile_col < tile_cols; tile_col++){
+                const int top = tile_row * tile_side;
+                const int left = tile_col * tile_side;
+                tiles.push_back(summarize(top, left, std::min(tile_side, grid_rows - top),
+                                          std::min(tile_side, grid_cols - left), labels));
+            }
+        }
+    }
+
+    /**
+    * @brief Counts the clusters inside a rectangle of the grid.
+    *
+    * Tiles that the rectangle covers completely use their stored summary; the others are clipped
+    * to the rectangle and summarized on the fly. All summaries are then joined along the tile
+    * borders.
+    *
+    * @param top The first row of the rectangle.
+    * @param left The first column of the rectangle.
+    * @param bottom One past the last row of the rectangle.
+    * @param right One past the last column of the rectangle.
+    * @return The number of clusters found in the rectangle, 0 for an empty rectangle.
+    * @throws std::invalid_argument If the rectangle does not lie within the grid.
+    */
+    int TileIndex::count_clusters(int top, int left, int bottom, int right) const{
+        if (top < 0 || left < 0 || bottom > grid_rows || right > grid_cols || top > bottom || left > right) {
+            throw std::invalid_argument("The rectangle must lie within the grid.");
+        }
+        if (top == bottom || left == right) {
+            return 0;
+        }
+
+        const int first_tile_row = top / tile_side;
+        const int first_tile_col = left / tile_side;
+        const int block_rows = (bottom - 1) / tile_side - first_tile_row + 1;
+        const int block_cols = (right - 1) / tile_side - first_tile_col + 1;
+
+        std::vector<TileSummary> clipped;
+        clipped.reserve(2 * (block_rows + block_cols));
+        std::vector<const TileSummary*> summaries;
+        summaries.reserve(static_cast<size_t>(block_rows) * block_cols);
+        std::vector<int> labels;
+
+        for (int tile_row = first_tile_row; tile_row < first_tile_row + block_rows; tile_row++){
+            const int tile_top = tile_row * tile_side;
+            const int tile_bottom = std::min(tile_top + tile_side, grid_rows);
+            const int region_top = std::max(top, tile_top);
+            const int region_bottom = std::min(bottom, tile_bottom);
+            for (int tile_col = first_tile_col; tile_col < first_tile_col + block_cols; tile_col++){
+                const int tile_left = tile_col * tile_side;
+                const int tile_right = std::min(tile_left + tile_side, grid_cols);
+                const int region_left = std::max(left, tile_left);
+                const int region_right = std::min(right, tile_right);
+
+                if (region_top == tile_top && region_bottom == tile_bottom &&
+                    region_left == tile_left && region_right == tile_right) {
+                    summaries.push_back(&tiles[static_cast<size_t>(tile_row) * tile_cols + tile_col]);
+                } else {
+                    clipped.push_back(summarize(region_top, region_left, region_bottom - region_top,
+                                                region_right - region_left, labels));
+                    summaries.push_back(&clipped.back());
+                }
+            }
+        }
+        return combine(summaries, block_rows, block_cols);
+    }
+
+    /**
+    * @brief Counts the clusters of the whole grid using only the stored tile summaries.
+    *
+    * @return The number of clusters found in the grid.
+    */
+    int TileIndex::count_clusters() const{
+        std::vector<const TileSummary*> summaries;
+        summaries.reserve(tiles.size());
+        for (const auto& tile : tiles){
+            summaries.push_back(&tile);
+        }
+        return combine(summaries, tile_rows, tile_cols);
+    }
+
+    /**
+    * @brief Labels a region of the grid and fills its summary.
+    *
+    * Cells are labeled in one raster pass that unites the labels of the upper and left
+    * neighbours. The roots of clusters touching a border are then renumbered compactly so that
+    * the summary only stores what a neighbouring tile can connect to.
+    *
+    * @param top The first row of the region.
+    * @param left The first column of the region.
+    * @param height The number of rows of the region.
+    * @param width The number of columns of the region.
+    * @param labels Scratch buffer reused between calls.
+    * @return The summary of the region.
+    */
+    TileIndex::TileSummary TileIndex::summarize(int top, int left, int height, int width,
+                                                std::vector<int>& labels) const{
+        labels.assign(static_cast<size_t>(height) * width, -1);
+        DisjointSet sets;
+        int unions = 0;
+
+        for (int row = 0; row < height; row++){
+            const auto& grid_row = grid[top + row];
+            int* current = labels.data() + static_cast<size_t>(row) * width;
+            const int* above = row > 0 ? current - width : nullptr;
+            for (int col = 0; col < width; col++){
+                if (!grid_row[left + col]) {
+                    continue;
+                }
+                const int up = above ? above[col] : -1;
+                const int back = col > 0 ? current[col - 1] : -1;
+                if (up < 0 && back < 0) {
+                    current[col] = sets.make_set();
+                } else if (up >= 0 && back >= 0) {
+                    current[col] = back;
+                    if (sets.unite(up, back)) {
+                        unions++;
+                    }
+                } else {
+                    current[col] = std::max(up, back);
+                }
+            }
+        }
+
+        TileSummary summary;
+        summary.clusters = static_cast<int>(sets.size()) - unions;
+        summary.top.resize(width);
+        summary.bottom.resize(width);
+        summary.left.resize(height);
+        summary.right.resize(height);
+
+        std::vector<int> compact(sets.size(), -1);
+        auto border_label = [&](int row, int col){
+            const int label = labels[static_cast<size_t>(row) * width + col];
+            if (label < 0) {
+                return -1;
+            }
+            const int root = sets.find(label);
+            if (compact[root] < 0) {
+                compact[root] = summary.border_clusters++;
+            }
+            return compact[root];
+        };
+        for (int col = 0; col < width; col++){
+            summary.top[col] = border_label(0, col);
+            summary.bottom[col] = border_label(height - 1, col);
+        }
+        for (int row = 0; row < height; row++){
+            summary.left[row] = border_label(row, 0);
+            summary.right[row] = border_label(row, width - 1);
+        }
+        return summary;
+    }
+
+    /**
+    * @brief Counts the clusters of a block of tiles, given the summary of each tile.
+    *
+    * Every border cluster gets a global id; clusters of adjacent tiles that face each other
+    * across a shared edge are united. The result is the sum of the per-tile counts minus the
+    * number of successful unions.
+    *
+    * @param summaries The tile summaries in row-major order.
+    * @param tile_rows The number of tile rows in the block.
+    * @param tile_cols The number of tile columns in the block.
+    * @return The number of clusters found in the block.
+    */
+    int TileIndex::combine(const std::vector<const TileSummary*>& summaries, int tile_rows, int tile_cols){
+        std::vector<int> bases(summaries.size());
+        int border_clusters = 0;
+        long long result = 0;
+        for (size_t tile = 0; tile < summaries.size(); tile++){
+            bases[tile] = border_clusters;
+            border_clusters += summaries[tile]->border_clusters;
+            result += summaries[tile]->clusters;
+        }
+
+        DisjointSet sets(border_clusters);
+        auto join = [&](const std::vector<int>& first, int first_base,
+                        const std::vector<int>& second, int second_base){
+            for (size_t cell = 0; cell < first.size(); cell++){
+                if (first[cell] >= 0 && second[cell] >= 0 &&
+                    sets.unite(first_base + first[cell], second_base + second[cell])) {
+                    result--;
+                }
+            }
+        };
+
+        for (int tile_row = 0; tile_row < tile_rows; tile_row++){
+            for (int tile_col = 0; tile_col < tile_cols; tile_col++){
+                const size_t tile = static_cast<size_t>(tile_row) * tile_cols + tile_col;
+                if (tile_col + 1 < tile_cols) {
+                    join(summaries[tile]->right, bases[tile], summaries[tile + 1]->left, bases[tile + 1]);
+                }
+                if (tile_row + 1 < tile_rows) {
+                    join(summaries[tile]->bottom, bases[tile],
+                         summaries[tile + tile_cols]->top, bases[tile + tile_cols]);
+                }
+            }
+        }
+        return static_cast<int>(result);
+    }
+}
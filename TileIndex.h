@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include "ClusterCounter.h"
+
+
+
+namespace clusters{
+
+    /**
+    * @class TileIndex
+    *
+    * @brief Precomputed index over a fixed grid that answers cluster counts inside rectangles.
+    *
+    * The grid is split into square tiles. For every tile the index stores the number of clusters
+    * that are fully contained in the tile and the cluster labels of the cells on its four borders.
+    * A query combines the stored summaries of the tiles that the rectangle covers completely,
+    * re-labels only the partially covered tiles along the rectangle edges, and joins neighbouring
+    * tiles through their border labels. The cost of a query therefore depends on the number of
+    * tiles and the length of the rectangle edges rather than on its area.
+    *
+    * The index keeps a reference to the grid, which must outlive the index and must not be
+    * modified after the index has been built.
+    */
+    class TileIndex{
+    public:
+
+        // @constant DEFAULT_TILE_SIZE Default side length of a tile, in cells.
+        static constexpr int DEFAULT_TILE_SIZE = 128;
+
+        /**
+        * @brief Builds the index for a grid.
+        *
+        * Every tile is labeled once, so building costs about as much as a single full count.
+        *
+        * @param grid The grid to be indexed. It must outlive the index and stay unchanged.
+        * @param tile_size The side length of a tile, in cells.
+        * @throws std::invalid_argument If the grid fails `ClusterCounter::validate_input` or
+        *         `tile_size` is not positive.
+        */
+        explicit TileIndex(const std::vector<std::vector<bool>>& grid, int tile_size = DEFAULT_TILE_SIZE);
+
+        /**
+        * @brief Counts the clusters inside a rectangle of the grid.
+        *
+        * The rectangle is half-open: it contains rows `top` .. `bottom`-1 and columns
+        * `left` .. `right`-1. Cells outside the rectangle are treated as 0, so a cluster that is
+        * cut by the rectangle may be counted as several clusters, exactly as if the rectangle
+        * had been copied into its own grid and passed to `ClusterCounter::count_clusters`.
+        *
+        * @param top The first row of the rectangle.
+        * @param left The first column of the rectangle.
+        * @param bottom One past the last row of the rectangle.
+        * @param right One past the last column of the rectangle.
+        * @return The number of clusters found in the rectangle, 0 for an empty rectangle.
+        * @throws std::invalid_argument If the rectangle does not lie within the grid.
+        */
+        int count_clusters(int top, int left, int bottom, int right) const;
+
+        /**
+        * @brief Counts the clusters of the whole grid using only the stored tile summaries.
+        *
+        * @return The number of clusters found in the grid.
+        */
+        int count_clusters() const;
+
+        // @brief Returns the number of rows of the indexed grid.
+        int rows() const { return grid_rows; }
+
+        // @brief Returns the number of columns of the indexed grid.
+        int cols() const { return grid_cols; }
+
+        // @brief Returns the side length of a tile, in cells.
+        int tile_size() const { return tile_side; }
+
+    private:
+
+        /**
+        * @struct TileSummary
+        *
+        * @brief Cluster summary of one rectangular region of the grid.
+        *
+        * Clusters touching a border of the region get compact labels 0 .. border_clusters-1,
+        * which are stored for every border cell (-1 for cells that are 0). Clusters that do not
+        * touch a border only contribute to `clusters`.
+        */
+        struct TileSummary{
+            int clusters = 0;
+            int border_clusters = 0;
+            std::vector<int> top;
+            std::vector<int> bottom;
+            std::vector<int> left;
+            std::vector<int> right;
+        };
+
+        /**
+        * @brief Labels a region of the grid and fills its summary.
+        *
+        * @param top The first row of the region.
+        * @param left The first column of the region.
+        * @param height The number of rows of the region.
+        * @param width The number of columns of the region.
+        * @param labels Scratch buffer reused between calls.
+        * @return The summary of the region.
+        */
+        TileSummary summarize(int top, int left, int height, int width, std::vector<int>& labels) const;
+
+        /**
+        * @brief Counts the clusters of a block of tiles, given the summary of each tile.
+        *
+        * @param summaries The tile summaries in row-major order.
+        * @param tile_rows The number of tile rows in the block.
+        * @param tile_cols The number of tile columns in the block.
+        * @return The number of clusters found in the block.
+        */
+        static int combine(const std::vector<const TileSummary*>& summaries, int tile_rows, int tile_cols);
+
+        const std::vector<std::vector<bool>>& grid;
+        int grid_rows;
+        int grid_cols;
+        int tile_side;
+        int tile_rows;
+        int tile_cols;
+        std::vector<TileSummary> tiles;
+    };
+}
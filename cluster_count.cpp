@@ -0,0 +1,347 @@
+#include<iostream>
+#include<vector>
+#include"ClusterCounter.h"
+#include"GridReader.h"
+#include"ScanKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace clusters;
+
+/**
+* cluster_count: counts the clusters of many grid files.
+*
+* A reader thread loads the files in order and keeps up to `--prefetch` loaded grids queued
+* ahead of a pool of counting threads, so reading and counting overlap and memory stays bounded.
+* Results are printed in input order as soon as they are available, followed by the totals.
+*/
+namespace{
+
+    const char* USAGE =
+        "Usage: cluster_count [options] FILE...\n"
+        "\n"
+        "Counts the 4-connected clusters of 'true' cells in every FILE.\n"
+        "\n"
+        "Options:\n"
+        "  --format FORMAT   auto (default), pbm, text or raw\n"
+        "  --raw ROWSxCOLS   read every file as raw packed words of the given size\n"
+        "  --threads N       number of counting threads (default: hardware threads)\n"
+        "  --prefetch N      number of grids read ahead of the counting threads (default: 2 x threads)\n"
+        "  --kernel ISA      scan kernel: scalar, sse4.2, avx2 or avx512 (default: best supported)\n"
+        "  --json            print the results as JSON\n"
+        "  --help            print this message\n";
+
+    struct Options{
+        std::vector<std::string> paths;
+        GridFormat format = GridFormat::Auto;
+        int raw_rows = 0;
+        int raw_cols = 0;
+        int threads = 0;
+        int prefetch = 0;
+        bool json = false;
+    };
+
+    struct FileResult{
+        bool done = false;
+        std::string error;
+        int rows = 0;
+        int cols = 0;
+        int clusters = 0;
+        double read_seconds = 0.0;
+        double count_seconds = 0.0;
+    };
+
+    struct Job{
+        size_t index = 0;
+        std::unique_ptr<PackedGrid> grid;
+        double read_seconds = 0.0;
+    };
+
+    /**
+    * @class JobQueue
+    *
+    * @brief A bounded queue between the reader thread and the counting threads.
+    */
+    class JobQueue{
+    public:
+        explicit JobQueue(size_t capacity) : capacity(capacity){}
+
+        // Blocks while the queue is full.
+        void push(Job job){
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this]{ return jobs.size() < capacity; });
+            jobs.push_back(std::move(job));
+            not_empty.notify_one();
+        }
+
+        // Blocks while the queue is empty and open; returns false once it is empty and closed.
+        bool pop(Job& job){
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this]{ return !jobs.empty() || closed; });
+            if (jobs.empty()) {
+                return false;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            not_full.notify_one();
+            return true;
+        }
+
+        void close(){
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            not_empty.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        bool closed = false;
+        std::deque<Job> jobs;
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+    };
+
+    /**
+    * @class Results
+    *
+    * @brief Per-file results, filled in any order and handed out in input order.
+    */
+    class Results{
+    public:
+        explicit Results(size_t count) : results(count){}
+
+        void finish(size_t index, FileResult result){
+            std::lock_guard<std::mutex> lock(mutex);
+            results[index] = std::move(result);
+            results[index].done = true;
+            ready.notify_all();
+        }
+
+        // Blocks until the result of a file is available.
+        FileResult wait(size_t index){
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this, index]{ return results[index].done; });
+            return results[index];
+        }
+
+    private:
+        std::vector<FileResult> results;
+        std::mutex mutex;
+        std::condition_variable ready;
+    };
+
+    double seconds_since(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::string json_string(const std::string& text){
+        std::string result = "\"";
+        for (char character : text){
+            if (character == '"' || character == '\\') {
+                result += '\\';
+                result += character;
+            } else if (static_cast<unsigned char>(character) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+                result += escaped;
+            } else {
+                result += character;
+            }
+        }
+        return result + "\"";
+    }
+
+    int parse_count(const std::string& option, const char* value){
+        char* end = nullptr;
+        const long count = std::strtol(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || count <= 0 || count > 4096) {
+            throw std::invalid_argument("Invalid value for " + option + ": " + value);
+        }
+        return static_cast<int>(count);
+    }
+
+    Options parse_options(int argc, char** argv){
+        Options options;
+        for (int i = 1; i < argc; i++){
+            const std::string argument = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (argument == "--help" || argument == "-h") {
+                std::cout << USAGE;
+                std::exit(0);
+            } else if (argument == "--json") {
+                options.json = true;
+            } else if (argument == "--format" && has_value) {
+                const std::string value = argv[++i];
+                if (value == "auto") {
+                    options.format = GridFormat::Auto;
+                } else if (value == "pbm") {
+                    options.format = GridFormat::Pbm;
+                } else if (value == "text") {
+                    options.format = GridFormat::Text;
+                } else if (value == "raw") {
+                    options.format = GridFormat::Raw;
+                } else {
+                    throw std::invalid_argument("Unknown format: " + value);
+                }
+            } else if (argument == "--raw" && has_value) {
+                const std::string value = argv[++i];
+                int consumed = 0;
+                if (std::sscanf(value.c_str(), "%dx%d%n", &options.raw_rows, &options.raw_cols, &consumed) != 2 ||
+                    consumed != static_cast<int>(value.size())) {
+                    throw std::invalid_argument("Invalid value for --raw: " + value);
+                }
+                options.format = GridFormat::Raw;
+            } else if (argument == "--threads" && has_value) {
+                options.threads = parse_count(argument, argv[++i]);
+            } else if (argument == "--prefetch" && has_value) {
+                options.prefetch = parse_count(argument, argv[++i]);
+            } else if (argument == "--kernel" && has_value) {
+                const std::string value = argv[++i];
+                bool found = false;
+                for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512}){
+                    if (value == ScanKernels::get(isa).name) {
+                        ScanKernels::force(isa);
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    throw std::invalid_argument("Unknown kernel: " + value);
+                }
+            } else if (argument.size() > 1 && argument[0] == '-') {
+                throw std::invalid_argument("Unknown option or missing value: " + argument);
+            } else {
+                options.paths.push_back(argument);
+            }
+        }
+        if (options.paths.empty()) {
+            throw std::invalid_argument("No input files.");
+        }
+        if (options.format == GridFormat::Raw && (options.raw_rows <= 0 || options.raw_cols <= 0)) {
+            throw std::invalid_argument("Raw files need their size: --raw ROWSxCOLS.");
+        }
+        if (options.threads == 0) {
+            options.threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (options.prefetch == 0) {
+            options.prefetch = 2 * options.threads;
+        }
+        return options;
+    }
+
+    // Loads every file in order; files that fail to load are finished right away.
+    void read_files(const Options& options, JobQueue& queue, Results& results){
+        for (size_t index = 0; index < options.paths.size(); index++){
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                std::unique_ptr<PackedGrid> grid(new PackedGrid(
+                    GridReader::read(options.paths[index], options.format, options.raw_rows, options.raw_cols)));
+                queue.push(Job{index, std::move(grid), seconds_since(start)});
+            } catch (const std::exception& e) {
+                FileResult result;
+                result.error = e.what();
+                result.read_seconds = seconds_since(start);
+                results.finish(index, std::move(result));
+            }
+        }
+        queue.close();
+    }
+
+    void count_files(JobQueue& queue, Results& results){
+        Job job;
+        while (queue.pop(job)) {
+            FileResult result;
+            result.rows = job.grid->rows();
+            result.cols = job.grid->cols();
+            result.read_seconds = job.read_seconds;
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                result.clusters = ClusterCounter::count_clusters(*job.grid);
+            } catch (const std::exception& e) {
+                result.error = e.what();
+            }
+            result.count_seconds = seconds_since(start);
+            job.grid.reset();
+            results.finish(job.index, std::move(result));
+        }
+    }
+
+    void print_result(const Options& options, const std::string& path, const FileResult& result, bool first){
+        if (options.json) {
+            std::printf("%s\n    {\"path\": %s, ", first ? "" : ",", json_string(path).c_str());
+            if (!result.error.empty()) {
+                std::printf("\"error\": %s}", json_string(result.error).c_str());
+            } else {
+                std::printf("\"rows\": %d, \"cols\": %d, \"clusters\": %d, \"read_ms\": %.3f, \"count_ms\": %.3f}",
+                            result.rows, result.cols, result.clusters, result.read_seconds * 1e3, result.count_seconds * 1e3);
+            }
+        } else if (!result.error.empty()) {
+            std::printf("%s: error: %s\n", path.c_str(), result.error.c_str());
+        } else {
+            std::printf("%s: %d clusters, %dx%d, read %.3f ms, count %.3f ms\n", path.c_str(), result.clusters,
+                        result.rows, result.cols, result.read_seconds * 1e3, result.count_seconds * 1e3);
+        }
+        std::fflush(stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "cluster_count: " << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    JobQueue queue(options.prefetch);
+    Results results(options.paths.size());
+    std::thread reader(read_files, std::cref(options), std::ref(queue), std::ref(results));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; i++){
+        workers.emplace_back(count_files, std::ref(queue), std::ref(results));
+    }
+
+    if (options.json) {
+        std::printf("{\n  \"files\": [");
+    }
+    size_t failed = 0;
+    long long cells = 0;
+    for (size_t index = 0; index < options.paths.size(); index++){
+        const FileResult result = results.wait(index);
+        if (result.error.empty()) {
+            cells += static_cast<long long>(result.rows) * result.cols;
+        } else {
+            failed++;
+        }
+        print_result(options, options.paths[index], result, index == 0);
+    }
+    reader.join();
+    for (std::thread& worker : workers){
+        worker.join();
+    }
+
+    const double seconds = seconds_since(start);
+    const double throughput = seconds > 0 ? cells / seconds : 0.0;
+    const char* kernel = ScanKernels::active().name;
+    if (options.json) {
+        std::printf("\n  ],\n  \"summary\": {\"files\": %zu, \"failed\": %zu, \"cells\": %lld, \"seconds\": %.6f, "
+                    "\"cells_per_second\": %.0f, \"threads\": %d, \"kernel\": \"%s\"}\n}\n",
+                    options.paths.size(), failed, cells, seconds, throughput, options.threads, kernel);
+    } else {
+        std::printf("%zu files (%zu failed), %lld cells in %.3f s, %.1f Mcells/s (%d threads, %s kernel)\n",
+                    options.paths.size(), failed, cells, seconds, throughput / 1e6, options.threads, kernel);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -1,7 +1,21 @@
 #include<iostream>
 #include<vector>
 #include"ClusterCounter.h"
+#include"TileIndex.h"
+#include"ScanKernels.h"
+#include"EnginePlanner.h"
+#include"LabelMap.h"
+#include"SlidingWindowCounter.h"
+#include"ApproximateCounter.h"
+#include"NarrowGridCounter.h"
+#include"GridReader.h"
+#include <cstdio>
+#include <set>
 #include <cassert>
+#include <random>
+#include <cmath>
+#include <array>
+#include <utility>
 
 using namespace clusters;
 
@@ -472,6 +486,620 @@ public:
 
 
 
+    // Random grid with a fixed seed, used to cross-check the engines against count_clusters
+    std::vector<std::vector<bool>> random_grid(int rows, int cols, double density, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::bernoulli_distribution cell(density);
+        std::vector<std::vector<bool>> grid(rows, std::vector<bool>(cols, 0));
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                grid[i][j] = cell(generator);
+            }
+        }
+        return grid;
+    }
+
+    // Copy of a rectangle of the grid
+    std::vector<std::vector<bool>> subgrid(const std::vector<std::vector<bool>>& grid, int top, int left, int bottom, int right) {
+        std::vector<std::vector<bool>> result;
+        for (int i = top; i < bottom; i++) {
+            result.emplace_back(grid[i].begin() + left, grid[i].begin() + right);
+        }
+        return result;
+    }
+
+    // Tile index queries must match count_clusters on the copied rectangle
+    void test_tile_index_rectangles() {
+        std::vector<std::vector<bool>> grid = random_grid(300, 270, 0.55, 26);
+        TileIndex index(grid, 32);
+        std::mt19937 generator(2026);
+        for (int query = 0; query < 200; query++) {
+            int top = generator() % 300, bottom = generator() % 300;
+            int left = generator() % 270, right = generator() % 270;
+            if (top > bottom) std::swap(top, bottom);
+            if (left > right) std::swap(left, right);
+            bottom++;
+            right++;
+            std::vector<std::vector<bool>> copy = subgrid(grid, top, left, bottom, right);
+            assert(index.count_clusters(top, left, bottom, right) == ClusterCounter::count_clusters(copy));
+        }
+        std::vector<std::vector<bool>> copy = grid;
+        assert(index.count_clusters() == ClusterCounter::count_clusters(copy));
+        assert(index.count_clusters(0, 0, 300, 270) == index.count_clusters());
+        assert(index.count_clusters(10, 10, 10, 50) == 0);
+        std::cout << "Tile index rectangle queries were successful" << std::endl;
+    }
+
+    // Rectangles outside of the grid are rejected
+    void test_tile_index_invalid_rectangle() {
+        std::vector<std::vector<bool>> grid(10, std::vector<bool>(10, 1));
+        TileIndex index(grid, 4);
+        try {
+            index.count_clusters(0, 0, 11, 10);
+            assert(false && "Exception should have been thrown for rectangle outside the grid");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "The rectangle must lie within the grid.");
+        }
+        try {
+            TileIndex invalid(grid, 0);
+            assert(false && "Exception should have been thrown for non-positive tile size");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "Tile size must be positive.");
+        }
+        std::cout << "Tile index invalid rectangle throw assertion was successful" << std::endl;
+    }
+
+    // Every scan kernel supported by this CPU must produce the same runs and counts as the BFS
+    void test_scan_kernels() {
+        const int widths[] = {1, 63, 64, 65, 128, 300, 1000};
+        const double densities[] = {0.0, 0.01, 0.5, 0.95, 1.0};
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (!ScanKernels::supported(isa)) {
+                continue;
+            }
+            ScanKernels::force(isa);
+            assert(ScanKernels::active().isa == isa);
+            for (int width : widths) {
+                std::vector<std::vector<std::vector<bool>>> grids;
+                for (double density : densities) {
+                    grids.push_back(random_grid(40, width, density, width));
+                }
+                // A checkerboard fills the run array of every row
+                grids.emplace_back(4, std::vector<bool>(width, 0));
+                for (int row = 0; row < 4; row++) {
+                    for (int col = 0; col < width; col++) {
+                        grids.back()[row][col] = (row + col) % 2;
+                    }
+                }
+                for (const auto& grid : grids) {
+                    PackedGrid packed(grid);
+                    std::vector<Run> runs(packed.words_per_row() * PackedGrid::WORD_BITS / 2);
+                    std::vector<Run> expected(runs.size());
+                    for (int row = 0; row < packed.rows(); row++) {
+                        size_t count = ScanKernels::active().extract_runs(packed.row(row), packed.words_per_row(), runs.data());
+                        size_t expected_count = ScanKernels::get(KernelIsa::Scalar).extract_runs(packed.row(row), packed.words_per_row(), expected.data());
+                        assert(count == expected_count);
+                        for (size_t run = 0; run < count; run++) {
+                            assert(runs[run].start == expected[run].start && runs[run].end == expected[run].end);
+                        }
+                    }
+                    assert(ClusterCounter::count_clusters(packed) == ClusterCounter::count_clusters(grid));
+                }
+            }
+            std::cout << "Scan kernel " << ScanKernels::active().name << " was successful" << std::endl;
+        }
+        ScanKernels::reset();
+        assert(ScanKernels::active().isa == ScanKernels::detect());
+    }
+
+    // Packed grids follow the same validation as count_clusters
+    void test_packed_grid_validation() {
+        try {
+            PackedGrid packed(0, 10);
+            assert(false && "Exception should have been thrown for no rows");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "std::vector<std::vector<bool>> cannot be empty or contain empty rows.");
+        }
+        try {
+            PackedGrid packed(50000, 50000);
+            assert(false && "Exception should have been thrown for large grid size");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "The number of cells exceeds 2^31 (maximum allowed cells).");
+        }
+        std::cout << "Packed grid throw assertion was successful" << std::endl;
+    }
+
+    // Every engine of the planner must agree with count_clusters
+    void test_planner_engines() {
+        const double densities[] = {0.02, 0.3, 0.6, 0.9};
+        for (double density : densities) {
+            const std::vector<std::vector<bool>> grid = random_grid(157, 211, density, 28);
+            std::vector<std::vector<bool>> copy = grid;
+            const int expected = ClusterCounter::count_clusters(copy);
+            for (Strategy strategy : {Strategy::InPlaceTraversal, Strategy::VisitedTraversal, Strategy::UnionFind,
+                                      Strategy::ParallelTiles, Strategy::Streaming}) {
+                for (unsigned threads : {1u, 2u, 7u, 400u}) {
+                    Plan plan;
+                    plan.strategy = strategy;
+                    plan.threads = threads;
+                    copy = grid;
+                    assert(EnginePlanner::execute(plan, copy) == expected);
+                }
+            }
+        }
+        std::cout << "Planner engines agreement was successful" << std::endl;
+    }
+
+    // The planner picks engines from density, mutability, budget and threads
+    void test_planner_choices() {
+        std::vector<std::vector<bool>> sparse = random_grid(500, 500, 0.01, 28);
+        assert(EnginePlanner::plan(sparse, true).strategy == Strategy::InPlaceTraversal);
+        assert(EnginePlanner::plan(sparse, false).strategy == Strategy::VisitedTraversal);
+        assert(EnginePlanner::plan(sparse, false, 100000).strategy == Strategy::Streaming);
+
+        std::vector<std::vector<bool>> dense = random_grid(500, 500, 0.6, 28);
+        assert(EnginePlanner::plan(dense, true, EnginePlanner::UNLIMITED_MEMORY, 1).strategy == Strategy::Streaming);
+
+        std::vector<std::vector<bool>> large(2048, std::vector<bool>(2048, 1));
+        PlannedCount result = EnginePlanner::count_clusters(large, EnginePlanner::UNLIMITED_MEMORY, 4);
+        assert(result.plan.strategy == Strategy::ParallelTiles && result.plan.threads == 4 && result.clusters == 1);
+
+        result = EnginePlanner::count_clusters(const_cast<const std::vector<std::vector<bool>>&>(dense), 1);
+        assert(!result.plan.reason.empty() && result.plan.estimated_bytes > 1);
+        std::vector<std::vector<bool>> copy = dense;
+        assert(result.clusters == ClusterCounter::count_clusters(copy));
+
+        Plan in_place;
+        in_place.strategy = Strategy::InPlaceTraversal;
+        try {
+            EnginePlanner::execute(in_place, const_cast<const std::vector<std::vector<bool>>&>(dense));
+            assert(false && "Exception should have been thrown for in-place traversal of a const grid");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "In-place traversal needs a grid that may be modified.");
+        }
+        std::cout << "Planner choices were successful" << std::endl;
+    }
+
+    // Draws an H of half-width `size` centred on a cell, with smaller H's centred on its four tips
+    void draw_h_tree(std::vector<std::vector<bool>>& grid, int row, int col, int size) {
+        for (int offset = -size; offset <= size; offset++) {
+            grid[row][col + offset] = 1;
+            grid[row + offset][col - size] = 1;
+            grid[row + offset][col + size] = 1;
+        }
+        if (size >= 4) {
+            for (int row_sign : {-1, 1}) {
+                for (int col_sign : {-1, 1}) {
+                    draw_h_tree(grid, row + row_sign * size, col + col_sign * size, size / 2);
+                }
+            }
+        }
+    }
+
+    // A sparse grid holding an H-tree, whose BFS frontier holds every branch at the same depth
+    // at once and outgrows MAX_QUEUE_SIZE, is still counted by the planner
+    void test_planner_queue_overflow() {
+        std::vector<std::vector<bool>> grid(2049, std::vector<bool>(24000, 0));
+        draw_h_tree(grid, 1024, 1024, 512);
+        for (int col = 2100; col < 24000; col += 7) {
+            grid[(col * 13) % 2049][col] = 1;
+        }
+        const int expected = ClusterCounter::count_clusters(PackedGrid(grid));
+        std::vector<std::vector<bool>> copy = grid;
+        try {
+            ClusterCounter::count_clusters(copy);
+            assert(false && "Exception should have been thrown for the BFS of an H-tree");
+        } catch (const QueueSizeExceededException&) {
+        }
+
+        Plan visited;
+        visited.strategy = Strategy::VisitedTraversal;
+        assert(EnginePlanner::execute(visited, std::as_const(grid)) == expected);
+
+        PlannedCount result = EnginePlanner::count_clusters(std::as_const(grid), EnginePlanner::UNLIMITED_MEMORY, 1);
+        assert(result.clusters == expected && result.plan.strategy == Strategy::Streaming);
+        assert(result.plan.reason.find("queue exceeded") != std::string::npos);
+
+        result = EnginePlanner::count_clusters(grid, EnginePlanner::UNLIMITED_MEMORY, 1);
+        assert(result.clusters == expected && result.plan.strategy == Strategy::UnionFind);
+        assert(result.plan.reason.find("queue exceeded") != std::string::npos);
+        std::cout << "Planner queue overflow was successful" << std::endl;
+    }
+
+    // Label map written to disk must label every cluster consistently
+    void test_label_map_round_trip() {
+        const std::string path = "label_map_test.bin";
+        for (double density : {0.0, 0.3, 0.6, 1.0}) {
+            std::vector<std::vector<bool>> grid = random_grid(120, 150, density, 29);
+            std::vector<std::vector<bool>> copy = grid;
+            const int expected = ClusterCounter::count_clusters(copy);
+            assert(LabelMapWriter::write(grid, path) == expected);
+
+            LabelMapReader reader(path);
+            assert(reader.rows() == 120 && reader.cols() == 150 && reader.clusters() == expected);
+            std::set<uint32_t> labels;
+            for (int i = 0; i < 120; i++) {
+                for (int j = 0; j < 150; j++) {
+                    const uint32_t label = reader.label(i, j);
+                    assert((label != 0) == grid[i][j]);
+                    if (label != 0) {
+                        labels.insert(label);
+                        assert(i == 0 || !grid[i - 1][j] || reader.label(i - 1, j) == label);
+                        assert(j == 0 || !grid[i][j - 1] || reader.label(i, j - 1) == label);
+                    }
+                }
+            }
+            assert(static_cast<int>(labels.size()) == expected);
+            assert(labels.empty() || (*labels.begin() == 1 && *labels.rbegin() == static_cast<uint32_t>(expected)));
+        }
+
+        PackedGrid packed(random_grid(3000, 700, 0.55, 29));
+        const int expected = ClusterCounter::count_clusters(packed);
+        assert(LabelMapWriter::write(packed, path) == expected);
+        LabelMapReader reader(path);
+        uint64_t runs = 0;
+        for (int i = 0; i < reader.rows(); i++) {
+            for (const LabeledRun& run : reader.row(i)) {
+                assert(packed.get(i, run.start) && packed.get(i, run.start + run.length - 1));
+                runs++;
+            }
+        }
+        assert(runs == reader.runs() && reader.clusters() == expected);
+        std::remove(path.c_str());
+        std::cout << "Label map round trip was successful" << std::endl;
+    }
+
+    // Files that are not label maps are rejected
+    void test_label_map_invalid_file() {
+        const std::string path = "label_map_invalid.bin";
+        FILE* file = std::fopen(path.c_str(), "wb");
+        std::fputs("not a label map, just some text that is long enough for a header", file);
+        std::fclose(file);
+        try {
+            LabelMapReader reader(path);
+            assert(false && "Exception should have been thrown for an invalid label map");
+        } catch (const std::runtime_error& e) {
+            assert(std::string(e.what()) == "Not a label map file: " + path + ".");
+        }
+
+        // A valid header whose index offset wraps around when the index size is added to it
+        const char magic[8] = {'C', 'L', 'S', 'T', 'R', 'L', 'E', '1'};
+        const uint32_t version = 1;
+        const int32_t size[2] = {1, 1};
+        const uint32_t clusters = 0;
+        const uint64_t run_count = 0;
+        const uint64_t index_offset = ~uint64_t(0) - 7;
+        const uint64_t padding = 0;
+        file = std::fopen(path.c_str(), "wb");
+        std::fwrite(magic, sizeof(magic), 1, file);
+        std::fwrite(&version, sizeof(version), 1, file);
+        std::fwrite(size, sizeof(size), 1, file);
+        std::fwrite(&clusters, sizeof(clusters), 1, file);
+        std::fwrite(&run_count, sizeof(run_count), 1, file);
+        std::fwrite(&index_offset, sizeof(index_offset), 1, file);
+        std::fwrite(&padding, sizeof(padding), 1, file);
+        std::fclose(file);
+        try {
+            LabelMapReader reader(path);
+            assert(false && "Exception should have been thrown for an index offset past the end of the file");
+        } catch (const std::runtime_error& e) {
+            assert(std::string(e.what()) == "Not a label map file: " + path + ".");
+        }
+        std::remove(path.c_str());
+        std::cout << "Label map invalid file throw assertion was successful" << std::endl;
+    }
+
+    // Sliding window must match count_clusters on the rows it currently holds
+    void test_sliding_window() {
+        const int height = 25;
+        std::vector<std::vector<bool>> stream = random_grid(400, 97, 0.55, 30);
+        SlidingWindowCounter window(97);
+        for (int i = 0; i < 400; i++) {
+            window.push_row(stream[i]);
+            if (window.rows() > height) {
+                window.pop_row();
+            }
+            std::vector<std::vector<bool>> copy(stream.begin() + std::max(0, i - height + 1), stream.begin() + i + 1);
+            assert(window.rows() == static_cast<int>(copy.size()));
+            assert(window.count_clusters() == ClusterCounter::count_clusters(copy));
+        }
+
+        // Popping the top of a U shape splits it into two clusters
+        SlidingWindowCounter u_shape(5);
+        u_shape.push_row({1, 1, 1, 1, 1});
+        u_shape.push_row({1, 0, 0, 0, 1});
+        u_shape.push_row({1, 0, 0, 0, 1});
+        assert(u_shape.count_clusters() == 1);
+        u_shape.pop_row();
+        assert(u_shape.count_clusters() == 2);
+        u_shape.pop_row();
+        u_shape.pop_row();
+        assert(u_shape.rows() == 0 && u_shape.count_clusters() == 0);
+        try {
+            u_shape.pop_row();
+            assert(false && "Exception should have been thrown for popping an empty window");
+        } catch (const std::out_of_range& e) {
+            assert(std::string(e.what()) == "Cannot pop a row from an empty window.");
+        }
+        try {
+            u_shape.push_row({1, 1});
+            assert(false && "Exception should have been thrown for a row of the wrong width");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "All rows in the grid must have the same number of cells.");
+        }
+        std::cout << "Sliding window was successful" << std::endl;
+    }
+
+    // Approximate count: exact when one tile covers the grid, close to the exact count when sampling
+    void test_approximate_count() {
+        ApproximateOptions whole;
+        whole.tile_size = 1000;
+        whole.max_sample_fraction = 1.0;
+        for (double density : {0.0, 0.3, 0.6, 0.9}) {
+            std::vector<std::vector<bool>> grid = random_grid(180, 230, density, 31);
+            std::vector<std::vector<bool>> copy = grid;
+            const int expected = ClusterCounter::count_clusters(copy);
+            ApproximateCount result = ApproximateCounter::count_clusters(grid, whole);
+            assert(result.estimate == expected && result.lower == expected && result.upper == expected);
+            assert(result.sampled_tiles == 1 && result.total_tiles == 1);
+        }
+
+        // Dense grids have many holes, which the estimate must account for
+        for (double density : {0.3, 0.7}) {
+            std::vector<std::vector<bool>> grid = random_grid(2000, 2000, density, 31);
+            std::vector<std::vector<bool>> copy = grid;
+            const int expected = ClusterCounter::count_clusters(copy);
+            ApproximateOptions sampled;
+            sampled.max_sample_fraction = 0.2;
+            ApproximateCount result = ApproximateCounter::count_clusters(grid, sampled);
+            assert(result.sampled_tiles < result.total_tiles);
+            assert(result.lower <= result.estimate && result.estimate <= result.upper);
+            assert(std::abs(result.estimate - expected) < 0.1 * expected);
+        }
+
+        // Over many seeds, the 95% interval covers the exact count about 95% of the time; the
+        // grid is not a multiple of the tile size, so partial tiles are sampled as well
+        for (double density : {0.05, 0.3}) {
+            std::vector<std::vector<bool>> grid = random_grid(2000, 2000, density, 32);
+            std::vector<std::vector<bool>> copy = grid;
+            const int expected = ClusterCounter::count_clusters(copy);
+            int covered = 0;
+            for (uint32_t seed = 0; seed < 100; seed++) {
+                ApproximateOptions options;
+                options.seed = seed;
+                const ApproximateCount result = ApproximateCounter::count_clusters(grid, options);
+                covered += result.lower <= expected && expected <= result.upper;
+            }
+            assert(covered >= 88);
+        }
+        std::cout << "Approximate count was successful" << std::endl;
+    }
+
+    // Invalid options are rejected
+    void test_approximate_invalid_options() {
+        std::vector<std::vector<bool>> grid(10, std::vector<bool>(10, 1));
+        ApproximateOptions options;
+        options.confidence = 1.0;
+        try {
+            ApproximateCounter::count_clusters(grid, options);
+            assert(false && "Exception should have been thrown for a confidence of 1");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "Approximate count options are out of range.");
+        }
+        std::cout << "Approximate count invalid options throw assertion was successful" << std::endl;
+    }
+
+    // Narrow grids: evaluated at compile time, and matching count_clusters at every width class
+    void test_narrow_grid() {
+        // A spiral and a U shape that is only joined through its bottom row
+        static_assert(NarrowGridCounter<5>::count_clusters(std::array<uint64_t, 5>{
+            0b11111, 0b10000, 0b10111, 0b10001, 0b11111}) == 1, "spiral");
+        static_assert(NarrowGridCounter<4>::count_clusters(std::array<uint64_t, 4>{
+            0b1001, 0b1001, 0b1001, 0b1111}) == 1, "U shape");
+        static_assert(NarrowGridCounter<4>::count_clusters(std::array<uint64_t, 3>{
+            0b0101, 0b1010, 0b0101}) == 6, "checkerboard");
+        static_assert(NarrowGridCounter<3>::count_clusters(std::array<uint64_t, 2>{
+            0b11111000, 0b11111000}) == 0, "bits past the width are ignored");
+
+        for (int density_step = 1; density_step <= 9; density_step += 2) {
+            const double density = density_step / 10.0;
+            std::vector<std::vector<bool>> grid1 = random_grid(300, 1, density, 32);
+            std::vector<std::vector<bool>> grid7 = random_grid(300, 7, density, 32);
+            std::vector<std::vector<bool>> grid33 = random_grid(300, 33, density, 32);
+            std::vector<std::vector<bool>> grid64 = random_grid(300, 64, density, 32);
+            assert(NarrowGridCounter<1>::count_clusters(grid1) == ClusterCounter::count_clusters(std::as_const(grid1)));
+            assert(NarrowGridCounter<7>::count_clusters(grid7) == ClusterCounter::count_clusters(std::as_const(grid7)));
+            assert(NarrowGridCounter<33>::count_clusters(grid33) == ClusterCounter::count_clusters(std::as_const(grid33)));
+            assert(NarrowGridCounter<64>::count_clusters(grid64) == ClusterCounter::count_clusters(std::as_const(grid64)));
+        }
+
+        std::vector<std::vector<bool>> grid(4, std::vector<bool>(8, 1));
+        try {
+            NarrowGridCounter<7>::count_clusters(grid);
+            assert(false && "Exception should have been thrown for a grid of the wrong width");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "The grid width must match the width of the counter.");
+        }
+        std::cout << "Narrow grid was successful" << std::endl;
+    }
+
+    // Writes a string to a file, byte for byte
+    void write_file(const std::string& path, const std::string& contents) {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        std::fwrite(contents.data(), 1, contents.size(), file);
+        std::fclose(file);
+    }
+
+    // Every supported file format must load the same cells
+    void test_grid_reader_formats() {
+        const std::string path = "grid_reader_test.dat";
+        const int rows = 37, cols = 131;
+        std::vector<std::vector<bool>> grid = random_grid(rows, cols, 0.5, 33);
+
+        std::string plain = "P1\n# plain bitmap\n131 37\n";
+        std::string binary = "P4 131\n37\n";
+        std::string text;
+        std::string raw;
+        for (int i = 0; i < rows; i++) {
+            std::string bytes((cols + 7) / 8, '\0');
+            for (int j = 0; j < cols; j++) {
+                plain += grid[i][j] ? "1 " : "0 ";
+                text += grid[i][j] ? '1' : '0';
+                bytes[j / 8] |= grid[i][j] << (7 - j % 8);
+            }
+            plain += '\n';
+            text += i % 2 ? "\r\n" : "\n\n";
+            binary += bytes;
+            for (int word = 0; word < 3; word++) {
+                uint64_t value = word == 2 ? ~uint64_t(0) << 3 : 0;   // padding bits are ignored
+                for (int j = word * 64; j < std::min(cols, word * 64 + 64); j++) {
+                    value |= uint64_t(grid[i][j]) << (j - word * 64);
+                }
+                for (int byte = 0; byte < 8; byte++) {
+                    raw += static_cast<char>(value >> (8 * byte));
+                }
+            }
+        }
+
+        const std::string files[] = {plain, binary, text, raw};
+        const GridFormat formats[] = {GridFormat::Auto, GridFormat::Auto, GridFormat::Auto, GridFormat::Raw};
+        for (int file = 0; file < 4; file++) {
+            write_file(path, files[file]);
+            PackedGrid packed = GridReader::read(path, formats[file], rows, cols);
+            assert(packed.rows() == rows && packed.cols() == cols);
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < cols; j++) {
+                    assert(packed.get(i, j) == grid[i][j]);
+                }
+            }
+            assert(ClusterCounter::count_clusters(packed) == ClusterCounter::count_clusters(std::as_const(grid)));
+        }
+        std::remove(path.c_str());
+        std::cout << "Grid reader formats was successful" << std::endl;
+    }
+
+    // Malformed grid files are rejected
+    void test_grid_reader_invalid_files() {
+        const std::string path = "grid_reader_invalid.dat";
+        const std::pair<std::string, std::string> cases[] = {
+            {"P4 16 4\n\xff\xff\xff\xff", "Not a pbm grid file: " + path + "."},
+            {"P1 2 2 1 0 1", "Not a pbm grid file: " + path + "."},
+            {"P4 65536 32768\n", "Not a pbm grid file: " + path + "."},
+            {"P1 40000 40000\n0 1", "Not a pbm grid file: " + path + "."},
+            {"0110\n01x0\n", "Not a text grid file: " + path + "."}
+        };
+        for (const auto& test_case : cases) {
+            write_file(path, test_case.first);
+            try {
+                GridReader::read(path);
+                assert(false && "Exception should have been thrown for a malformed grid file");
+            } catch (const std::runtime_error& e) {
+                assert(std::string(e.what()) == test_case.second);
+            }
+        }
+        write_file(path, "0110\n010\n");
+        try {
+            GridReader::read(path);
+            assert(false && "Exception should have been thrown for rows of different lengths");
+        } catch (const std::invalid_argument& e) {
+            assert(std::string(e.what()) == "All rows in the grid must have the same number of cells.");
+        }
+        write_file(path, std::string(24, '\0'));
+        try {
+            GridReader::read(path, GridFormat::Raw, 2, 64);
+            assert(false && "Exception should have been thrown for a raw file of the wrong size");
+        } catch (const std::runtime_error& e) {
+            assert(std::string(e.what()) == "Not a raw grid file: " + path + ".");
+        }
+        std::remove(path.c_str());
+        try {
+            GridReader::read(".");
+            assert(false && "Exception should have been thrown for a directory");
+        } catch (const std::runtime_error& e) {
+            assert(std::string(e.what()) == "Cannot read grid file: ..");
+        }
+        std::cout << "Grid reader invalid files throw assertion was successful" << std::endl;
+    }
+
+    // Holes by flood filling the 8-connected 'false' regions of the grid padded with a 'false' border
+    long long count_holes(const std::vector<std::vector<bool>>& grid) {
+        const int rows = grid.size() + 2, cols = grid[0].size() + 2;
+        std::vector<std::vector<bool>> background(rows, std::vector<bool>(cols, true));
+        for (int i = 1; i + 1 < rows; i++) {
+            for (int j = 1; j + 1 < cols; j++) {
+                background[i][j] = !grid[i - 1][j - 1];
+            }
+        }
+        long long regions = 0;
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                if (!background[i][j]) {
+                    continue;
+                }
+                regions++;
+                std::vector<std::pair<int, int>> stack = {{i, j}};
+                background[i][j] = false;
+                while (!stack.empty()) {
+                    const auto cell = stack.back();
+                    stack.pop_back();
+                    for (int di = -1; di <= 1; di++) {
+                        for (int dj = -1; dj <= 1; dj++) {
+                            const int ni = cell.first + di, nj = cell.second + dj;
+                            if (ni >= 0 && ni < rows && nj >= 0 && nj < cols && background[ni][nj]) {
+                                background[ni][nj] = false;
+                                stack.push_back({ni, nj});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return regions - 1;
+    }
+
+    // Perimeter, Euler number and holes from bit-quads must match direct counts on every kernel
+    void test_grid_statistics() {
+        std::vector<std::vector<bool>> ring = {
+            {1, 1, 1, 0},
+            {1, 0, 1, 0},
+            {1, 1, 1, 0},
+            {0, 0, 0, 1}
+        };
+        GridStatistics statistics = ClusterCounter::count_statistics(PackedGrid(ring));
+        assert(statistics.clusters == 2 && statistics.holes == 1 && statistics.euler_number == 1);
+        assert(statistics.perimeter == 16 + 4);
+
+        const int widths[] = {1, 63, 64, 65, 130, 300};
+        const double densities[] = {0.0, 0.3, 0.6, 0.85, 1.0};
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE42, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            if (!ScanKernels::supported(isa)) {
+                continue;
+            }
+            ScanKernels::force(isa);
+            for (int width : widths) {
+                for (double density : densities) {
+                    std::vector<std::vector<bool>> grid = random_grid(50, width, density, 34 + width);
+                    long long perimeter = 0;
+                    for (int i = 0; i < 50; i++) {
+                        for (int j = 0; j < width; j++) {
+                            if (grid[i][j]) {
+                                perimeter += (i == 0 || !grid[i - 1][j]) + (i == 49 || !grid[i + 1][j]) +
+                                             (j == 0 || !grid[i][j - 1]) + (j + 1 == width || !grid[i][j + 1]);
+                            }
+                        }
+                    }
+                    statistics = ClusterCounter::count_statistics(PackedGrid(grid));
+                    assert(statistics.clusters == ClusterCounter::count_clusters(std::as_const(grid)));
+                    assert(statistics.perimeter == perimeter);
+                    assert(statistics.holes == count_holes(grid));
+                    assert(statistics.euler_number == statistics.clusters - statistics.holes);
+                }
+            }
+        }
+        ScanKernels::reset();
+        std::cout << "Grid statistics was successful" << std::endl;
+    }
+
     // Run all tests
     void run_all_tests() {
 
@@ -502,6 +1130,23 @@ public:
         test_large_grid_20_million_random_clusters();
         test_large_grid_100_million_random_clusters();
         test_large_grid_50k_by_40k_random_clusters();
+
+        test_tile_index_rectangles();
+        test_tile_index_invalid_rectangle();
+        test_scan_kernels();
+        test_packed_grid_validation();
+        test_planner_engines();
+        test_planner_choices();
+        test_planner_queue_overflow();
+        test_label_map_round_trip();
+        test_label_map_invalid_file();
+        test_sliding_window();
+        test_approximate_count();
+        test_approximate_invalid_options();
+        test_narrow_grid();
+        test_grid_reader_formats();
+        test_grid_reader_invalid_files();
+        test_grid_statistics();
     
     }
 };